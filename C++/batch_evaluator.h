@@ -0,0 +1,199 @@
+#ifndef BATCH_EVALUATOR_H_
+#define BATCH_EVALUATOR_H_
+
+#include "evaluator.h"
+
+#include <cstddef>
+
+// Scores many candidate boards at once. The boards are transposed into
+// structure-of-arrays form, BATCH_LANES at a time, and every feature is
+// worked out from row masks with loops over the lanes that the compiler
+// vectorizes, so one instruction advances a feature for a whole group of
+// boards. The features match the scalar get_* functions in evaluator.h
+// exactly. As with Evaluator, a FEATURES mask fixed at compile time says
+// which features take part; the work for the others is left out of the loop.
+
+#define BATCH_LANES 16
+
+// A board that a block has just been dropped onto, reduced to what the
+// features need.
+template <int ROWS, int COLS>
+struct BasicPackedBoard {
+  typedef typename RowMaskFor<COLS>::type RowMask;
+
+  RowMask row_masks[ROWS];
+  int landing_height;
+  int rows_removed;
+};
+
+typedef BasicPackedBoard<DEFAULT_ROWS, DEFAULT_COLS> PackedBoard;
+
+// Packs `board`, which a block was just dropped onto, landing at row
+// `landing_height` and clearing `rows_removed` rows.
+template <int ROWS, int COLS>
+void pack_board(const BasicBoard<ROWS, COLS>& board, int landing_height, int rows_removed,
+                BasicPackedBoard<ROWS, COLS>* packed) {
+  for (int i = 0; i < ROWS; i++) {
+    packed->row_masks[i] = board.row_masks[i];
+  }
+  packed->landing_height = landing_height;
+  packed->rows_removed = rows_removed;
+}
+
+inline uint64_t mix_hash(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+// Hashes everything a packed board's score depends on, so boards that hash
+// alike can share one score.
+template <int ROWS, int COLS>
+uint64_t board_hash(const BasicPackedBoard<ROWS, COLS>& board) {
+  uint64_t h = (uint64_t)ROWS << 8 | COLS;
+  for (int i = 0; i < ROWS; i++) {
+    h = (h ^ board.row_masks[i]) * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 29;
+  }
+  h ^= (uint64_t)(uint32_t)board.landing_height << 32 | (uint32_t)board.rows_removed;
+  return mix_hash(h);
+}
+
+// A population count written with shifts, masks and adds only, which
+// vectorizes where __builtin_popcount doesn't without a vector popcount
+// instruction. The bytes are summed by folding rather than by the usual
+// multiply, which GCC recognizes as a popcount and turns back into the
+// scalar instruction wherever the target has one.
+template <typename T>
+inline int lane_popcount(T x) {
+  x = x - ((x >> 1) & (T)0x5555555555555555ULL);
+  x = (x & (T)0x3333333333333333ULL) + ((x >> 2) & (T)0x3333333333333333ULL);
+  x = (x + (x >> 4)) & (T)0x0f0f0f0f0f0f0f0fULL;
+  for (int shift = 8; shift < 8 * (int)sizeof(T); shift *= 2) {
+    x = x + (x >> shift);
+  }
+  return (int)(x & 0x7f);
+}
+
+// Scores the first `count` (at most BATCH_LANES) of `boards` into `out`,
+// and their features into `features` unless it's NULL, laid out as in
+// evaluate_batch.
+template <unsigned FEATURES, int ROWS, int COLS>
+void evaluate_lanes(const BasicPackedBoard<ROWS, COLS>* boards, int count, float* out,
+                    const Weights& weights, int* features) {
+  static_assert(COLS < 64, "evaluate_batch needs a spare bit above the last column");
+  // One spare bit above the last column, so row transitions can see the wall.
+  typedef typename RowMaskFor<COLS + 1>::type Lane;
+  const Lane FULL = (Lane)(~(uint64_t)0 >> (64 - COLS));
+  const Lane LEFT_WALL = 1;
+  const Lane RIGHT_WALL = (Lane)1 << COLS;
+  const Lane LAST_COL = (Lane)1 << (COLS - 1);
+
+  Lane rows[ROWS][BATCH_LANES];
+  for (int i = 0; i < ROWS; i++) {
+    for (int l = 0; l < BATCH_LANES; l++) {
+      rows[i][l] = l < count ? boards[l].row_masks[i] : 0;
+    }
+  }
+
+  int holes[BATCH_LANES] = {0};
+  int row_transitions[BATCH_LANES] = {0};
+  int col_transitions[BATCH_LANES] = {0};
+  int well_sums[BATCH_LANES] = {0};
+  // The row above the current one, starting with the ceiling, which counts
+  // as filled.
+  Lane above[BATCH_LANES];
+  // The columns with a filled square at or above the current row.
+  Lane roof[BATCH_LANES];
+  // The columns where a well has started at or above the current row.
+  Lane wells[BATCH_LANES];
+  for (int l = 0; l < BATCH_LANES; l++) {
+    above[l] = FULL;
+    roof[l] = 0;
+    wells[l] = 0;
+  }
+
+  const bool HOLES_USED = FEATURES & FEATURE_BIT(HOLES);
+  const bool ROW_TRANSITIONS_USED = FEATURES & FEATURE_BIT(ROW_TRANSITIONS);
+  const bool COL_TRANSITIONS_USED = FEATURES & FEATURE_BIT(COL_TRANSITIONS);
+  const bool WELL_SUMS_USED = FEATURES & FEATURE_BIT(WELL_SUMS);
+  for (int i = 0; i < ROWS; i++) {
+    for (int l = 0; l < BATCH_LANES; l++) {
+      Lane row = rows[i][l];
+      Lane empty = ~row & FULL;
+      if (HOLES_USED) {
+        // Rows with nothing in them don't count as holes.
+        holes[l] += lane_popcount(empty) & -(int)(row != 0);
+      }
+      if (ROW_TRANSITIONS_USED) {
+        // Compare each square with its left neighbour, with the walls filled.
+        row_transitions[l] += lane_popcount((Lane)(((row << 1) | LEFT_WALL) ^ (row | RIGHT_WALL)));
+      }
+      if (COL_TRANSITIONS_USED) {
+        col_transitions[l] += lane_popcount((Lane)(above[l] ^ row));
+        above[l] = row;
+      }
+      if (WELL_SUMS_USED) {
+        // A well starts at the first empty, uncovered square with both
+        // neighbours filled, and takes in every empty square below it.
+        roof[l] |= row;
+        Lane left_filled = (row << 1) | LEFT_WALL;
+        Lane right_filled = (row >> 1) | LAST_COL;
+        wells[l] |= ~roof[l] & left_filled & right_filled & FULL;
+        well_sums[l] += lane_popcount((Lane)(wells[l] & empty));
+      }
+    }
+  }
+  if (COL_TRANSITIONS_USED) {
+    // The floor counts as filled too.
+    for (int l = 0; l < BATCH_LANES; l++) {
+      col_transitions[l] += lane_popcount((Lane)(~above[l] & FULL));
+    }
+  }
+
+  // Summed in feature order, in double, like Evaluator::score.
+  for (int l = 0; l < count; l++) {
+    int values[NUM_FEATURES];
+    values[ROWS_REMOVED] = boards[l].rows_removed;
+    values[LANDING_HEIGHT] = boards[l].landing_height;
+    values[HOLES] = holes[l];
+    values[ROW_TRANSITIONS] = row_transitions[l];
+    values[COL_TRANSITIONS] = col_transitions[l];
+    values[WELL_SUMS] = well_sums[l];
+    values[POINTS_EARNED] = points_earned(boards[l].rows_removed);
+    double score = 0;
+    for (int f = 0; f < NUM_FEATURES; f++) {
+      if (FEATURES & FEATURE_BIT(f)) {
+        score += values[f] * weights.weights[f];
+      }
+    }
+    out[l] = score;
+    if (features) {
+      for (int f = 0; f < NUM_FEATURES; f++) {
+        if (FEATURES & FEATURE_BIT(f)) {
+          features[l * NUM_FEATURES + f] = values[f];
+        }
+      }
+    }
+  }
+}
+
+// Scores `n` boards into out[0..n) with the features in FEATURES, which
+// should cover every feature whose weight is nonzero. If `features` isn't
+// NULL, feature f of board k is written to features[k * NUM_FEATURES + f],
+// for each f in FEATURES; the others are left untouched.
+template <unsigned FEATURES = ALL_FEATURES, int ROWS, int COLS>
+void evaluate_batch(const BasicPackedBoard<ROWS, COLS>* boards, size_t n, float* out,
+                    const Weights& weights = SHIPPED_WEIGHTS,
+                    int* features = NULL) {
+  for (size_t k = 0; k < n; k += BATCH_LANES) {
+    int count = n - k < BATCH_LANES ? (int)(n - k) : BATCH_LANES;
+    evaluate_lanes<FEATURES>(boards + k, count, out + k, weights,
+                             features ? features + k * NUM_FEATURES : NULL);
+  }
+}
+
+#endif  // BATCH_EVALUATOR_H_
@@ -0,0 +1,321 @@
+// Times the engine's primitive operations, one at a time, over a corpus of
+// mid-game boards recorded from self-play (record_states in simulator.h).
+//
+//   bench_primitives [--games N] [--min-time SECONDS] [--filter TEXT] [--json]
+//
+// records a state every 10 turns of N games (default 8), then runs each
+// benchmark whose name contains TEXT for at least SECONDS (default 0.2) and
+// prints the time per operation. --json prints the results in the layout
+// Google Benchmark uses for its JSON output instead, for diffing between
+// builds.
+//
+// An operation is one call of the primitive on one board or placement:
+//
+//   parse_json, parse_binary   parsing a state (and freeing its blocks)
+//   check                      one check() of the block at a translation
+//                              and rotation, in or out of bounds
+//   generate_placements        every placement of a board's block
+//   place_into                 dropping the block from one placement
+//   remove_rows                copying a board with its bottom row filled,
+//                              and removing that row
+//   get_*                      one feature of a board a block landed on
+//   calc_score                 scoring one placement feature by feature
+//   evaluate_batch             scoring one placement, in batches
+//   pick_move                  picking a move for a board, as play() does
+
+#include "dropblox_ai.h"
+#include "batch_evaluator.h"
+#include "engine.h"
+#include "evaluator.h"
+#include "simulator.h"
+#include "state_binary.h"
+#include "state_parser.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+using namespace std;
+
+typedef BasicBoard<DEFAULT_ROWS, DEFAULT_COLS> BenchBoard;
+
+// Keeps the compiler from discarding the results of the code under test.
+static volatile int sink;
+
+static void usage(const char* name) {
+  cerr << "Usage: " << name << " [--games N] [--min-time SECONDS] [--filter TEXT] [--json]"
+       << endl;
+  exit(1);
+}
+
+static void free_blocks(GameState* state) {
+  delete state->block;
+  for (size_t k = 0; k < state->preview.size(); k++) {
+    delete state->preview[k];
+  }
+  state->block = NULL;
+  state->preview.clear();
+}
+
+// A board from the corpus, in every form the benchmarks need.
+struct CorpusBoard {
+  string json;
+  string binary;
+  BenchBoard* board;
+  vector<Placement> placements;
+  // The board each placement lands on, with its landing height and rows
+  // removed.
+  vector<BenchBoard> landed;
+  vector<BasicPackedBoard<DEFAULT_ROWS, DEFAULT_COLS> > packed;
+};
+
+struct BenchmarkResult {
+  string name;
+  long iterations;
+  long operations;
+  double real_ns;
+  double cpu_ns;
+};
+
+// Calls `body`, which does `operations` operations, often enough to take at
+// least `min_time` seconds, and returns the time per operation.
+template <typename Body>
+BenchmarkResult run_benchmark(const string& name, long operations, double min_time, Body body) {
+  typedef chrono::steady_clock Clock;
+  long iterations = 1;
+  while (true) {
+    clock_t cpu_start = clock();
+    Clock::time_point start = Clock::now();
+    for (long k = 0; k < iterations; k++) {
+      body();
+    }
+    double elapsed = chrono::duration<double>(Clock::now() - start).count();
+    double cpu = (double)(clock() - cpu_start) / CLOCKS_PER_SEC;
+    if (elapsed >= min_time || iterations >= (1L << 30)) {
+      BenchmarkResult result;
+      result.name = name;
+      result.iterations = iterations;
+      result.operations = iterations * operations;
+      result.real_ns = 1e9 * elapsed / result.operations;
+      result.cpu_ns = 1e9 * cpu / result.operations;
+      return result;
+    }
+    // Aim a little past min_time, growing at least twofold and at most
+    // a hundredfold.
+    long next = elapsed > 0 ? (long)(iterations * 1.4 * min_time / elapsed) : iterations * 100;
+    iterations = max(iterations * 2, min(iterations * 100, next));
+  }
+}
+
+int main(int argc, char** argv) {
+  int games = 8;
+  double min_time = 0.2;
+  const char* filter = "";
+  bool json = false;
+  for (int k = 1; k < argc; k++) {
+    if (strcmp(argv[k], "--json") == 0) {
+      json = true;
+      continue;
+    }
+    if (k + 1 == argc) {
+      usage(argv[0]);
+    }
+    if (strcmp(argv[k], "--games") == 0) {
+      games = atoi(argv[++k]);
+    } else if (strcmp(argv[k], "--min-time") == 0) {
+      min_time = atof(argv[++k]);
+    } else if (strcmp(argv[k], "--filter") == 0) {
+      filter = argv[++k];
+    } else {
+      usage(argv[0]);
+    }
+  }
+
+  engine_debug = false;
+  vector<string> states;
+  record_states<DEFAULT_ROWS, DEFAULT_COLS>(1, games, 10, 0, SIMULATED_BLOCK_SIZE, &states);
+  if (states.empty()) {
+    cerr << "No states recorded" << endl;
+    return 1;
+  }
+
+  vector<CorpusBoard> corpus(states.size());
+  long placements = 0;
+  for (size_t b = 0; b < states.size(); b++) {
+    CorpusBoard& entry = corpus[b];
+    entry.json = states[b];
+    GameState state;
+    parse_game_state(entry.json.data(), entry.json.data() + entry.json.size(), &state);
+    write_binary_state(state, &entry.binary);
+    entry.board = new BenchBoard(state);
+    generate_placements(*entry.board, &entry.placements);
+    entry.landed.resize(entry.placements.size());
+    entry.packed.resize(entry.placements.size());
+    for (size_t p = 0; p < entry.placements.size(); p++) {
+      Point translation = {0, entry.placements[p].translation};
+      Point landing;
+      int rows = entry.board->place_into(*entry.board->block, translation,
+                                         entry.placements[p].rotation, &entry.landed[p],
+                                         &landing);
+      pack_board(entry.landed[p], entry.board->block->center.i + landing.i, rows,
+                 &entry.packed[p]);
+    }
+    placements += entry.placements.size();
+  }
+  long boards = corpus.size();
+
+  vector<BenchmarkResult> results;
+#define BENCHMARK(NAME, OPERATIONS, ...)                                    \
+  if (strstr(NAME, filter)) {                                               \
+    results.push_back(run_benchmark(NAME, OPERATIONS, min_time,             \
+                                    [&]() __VA_ARGS__));                    \
+    if (!json) {                                                            \
+      const BenchmarkResult& result = results.back();                       \
+      printf("%-22s %10.1f ns/op %14ld ops\n", result.name.c_str(),         \
+             result.real_ns, result.operations);                            \
+      fflush(stdout);                                                       \
+    }                                                                       \
+  }
+
+  BENCHMARK("parse_json", boards, {
+    for (size_t b = 0; b < corpus.size(); b++) {
+      GameState state;
+      const string& text = corpus[b].json;
+      parse_game_state(text.data(), text.data() + text.size(), &state);
+      sink += state.rows;
+      free_blocks(&state);
+    }
+  });
+  BENCHMARK("parse_binary", boards, {
+    for (size_t b = 0; b < corpus.size(); b++) {
+      GameState state;
+      const string& data = corpus[b].binary;
+      parse_binary_state(data.data(), data.data() + data.size(), &state);
+      sink += state.rows;
+      free_blocks(&state);
+    }
+  });
+  BENCHMARK("check", boards * 4 * (2 * DEFAULT_COLS + 1), {
+    int valid = 0;
+    for (size_t b = 0; b < corpus.size(); b++) {
+      const BenchBoard& board = *corpus[b].board;
+      for (int rotation = 0; rotation < 4; rotation++) {
+        for (int j = -DEFAULT_COLS; j <= DEFAULT_COLS; j++) {
+          Point translation = {0, j};
+          valid += board.check(*board.block, translation, rotation);
+        }
+      }
+    }
+    sink += valid;
+  });
+  vector<Placement> scratch_placements;
+  scratch_placements.reserve(8 * DEFAULT_COLS);
+  BENCHMARK("generate_placements", boards, {
+    for (size_t b = 0; b < corpus.size(); b++) {
+      scratch_placements.clear();
+      generate_placements(*corpus[b].board, &scratch_placements);
+      sink += scratch_placements.size();
+    }
+  });
+  BenchBoard scratch_board;
+  BENCHMARK("place_into", placements, {
+    for (size_t b = 0; b < corpus.size(); b++) {
+      const BenchBoard& board = *corpus[b].board;
+      for (size_t p = 0; p < corpus[b].placements.size(); p++) {
+        Point translation = {0, corpus[b].placements[p].translation};
+        Point landing;
+        sink += board.place_into(*board.block, translation, corpus[b].placements[p].rotation,
+                                 &scratch_board, &landing);
+      }
+    }
+  });
+  vector<BenchBoard> full_bottom(corpus.size());
+  for (size_t b = 0; b < corpus.size(); b++) {
+    full_bottom[b] = *corpus[b].board;
+    for (int j = 0; j < DEFAULT_COLS; j++) {
+      full_bottom[b].bitmap[DEFAULT_ROWS - 1][j] = 1;
+    }
+  }
+  BENCHMARK("remove_rows", boards, {
+    for (size_t b = 0; b < corpus.size(); b++) {
+      memcpy(scratch_board.bitmap, full_bottom[b].bitmap, sizeof(BenchBoard::Bitmap));
+      sink += BenchBoard::remove_rows(&scratch_board.bitmap);
+    }
+  });
+  BENCHMARK("get_number_of_holes", placements, {
+    for (size_t b = 0; b < corpus.size(); b++) {
+      for (size_t p = 0; p < corpus[b].landed.size(); p++) {
+        sink += get_number_of_holes(&corpus[b].landed[p]);
+      }
+    }
+  });
+  BENCHMARK("get_row_transitions", placements, {
+    for (size_t b = 0; b < corpus.size(); b++) {
+      for (size_t p = 0; p < corpus[b].landed.size(); p++) {
+        sink += get_row_transitions(&corpus[b].landed[p]);
+      }
+    }
+  });
+  BENCHMARK("get_col_transitions", placements, {
+    for (size_t b = 0; b < corpus.size(); b++) {
+      for (size_t p = 0; p < corpus[b].landed.size(); p++) {
+        sink += get_col_transitions(&corpus[b].landed[p]);
+      }
+    }
+  });
+  BENCHMARK("get_well_sum", placements, {
+    for (size_t b = 0; b < corpus.size(); b++) {
+      for (size_t p = 0; p < corpus[b].landed.size(); p++) {
+        sink += get_well_sum(&corpus[b].landed[p]);
+      }
+    }
+  });
+  BENCHMARK("calc_score", placements, {
+    float total = 0;
+    for (size_t b = 0; b < corpus.size(); b++) {
+      const BenchBoard& board = *corpus[b].board;
+      for (size_t p = 0; p < corpus[b].placements.size(); p++) {
+        Point translation = {0, corpus[b].placements[p].translation};
+        total += calc_score(board, translation, corpus[b].placements[p].rotation,
+                            &scratch_board);
+      }
+    }
+    sink += (int)total;
+  });
+  vector<float> scores(8 * DEFAULT_COLS);
+  BENCHMARK("evaluate_batch", placements, {
+    for (size_t b = 0; b < corpus.size(); b++) {
+      evaluate_batch(corpus[b].packed.data(), corpus[b].packed.size(), scores.data());
+      sink += (int)scores[0];
+    }
+  });
+  MoveScratch<DEFAULT_ROWS, DEFAULT_COLS> move_scratch;
+  BENCHMARK("pick_move", boards, {
+    for (size_t b = 0; b < corpus.size(); b++) {
+      sink += pick_move(*corpus[b].board, &move_scratch).size();
+    }
+  });
+#undef BENCHMARK
+
+  if (json) {
+    printf("{\n  \"context\": {\n");
+    printf("    \"executable\": \"%s\",\n", argv[0]);
+    printf("    \"corpus_boards\": %ld,\n", boards);
+    printf("    \"corpus_placements\": %ld,\n", placements);
+    printf("    \"rows\": %d,\n    \"cols\": %d,\n", DEFAULT_ROWS, DEFAULT_COLS);
+    printf("    \"min_time\": %g\n  },\n", min_time);
+    printf("  \"benchmarks\": [");
+    for (size_t k = 0; k < results.size(); k++) {
+      const BenchmarkResult& result = results[k];
+      printf("%s\n    {\"name\": \"%s\", \"iterations\": %ld, \"operations\": %ld, "
+             "\"real_time\": %.3f, \"cpu_time\": %.3f, \"time_unit\": \"ns\"}",
+             k ? "," : "", result.name.c_str(), result.iterations, result.operations,
+             result.real_ns, result.cpu_ns);
+    }
+    printf("\n  ]\n}\n");
+  }
+  return 0;
+}
@@ -0,0 +1,258 @@
+// Measures the engine's strength and speed together, by playing seeded games
+// against the simulator in simulator.h on every core.
+//
+//   bench_selfplay [--games N] [--seed S] [--turns T] [--block-size K]
+//                  [--threads J] [--weights FILE]
+//                  [--baseline FILE] [--early-stop] [--z Z]
+//
+// plays N games (default 100) with seeds S, S+1, ... (default 1), each for at
+// most T turns (default no limit) with blocks of up to K squares, spread over
+// J threads (default one per core). It reports the distribution of scores,
+// lines cleared and game lengths, and percentiles of how long the engine took
+// to pick each move. --weights plays with weights from a file written by tune
+// instead of the shipped ones.
+//
+// The games depend only on their seeds, so two builds given the same options
+// play the same games: a change that should only make the engine faster must
+// leave the scores exactly as they were.
+//
+// --baseline also plays every seed with the weights in FILE ("shipped" for
+// the shipped weights), and reports the mean paired score difference and its
+// standard error. With --early-stop, games stop once the difference is more
+// than Z (default 2) standard errors from zero. The baseline's games count
+// toward the elapsed time but not toward moves/s, so benchmark speed without
+// --baseline.
+
+#include "dropblox_ai.h"
+#include "paired_stats.h"
+#include "simulator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+static void usage(const char* name) {
+  cerr << "Usage: " << name << " [--games N] [--seed S] [--turns T] [--block-size K]"
+       << " [--threads J] [--weights FILE] [--baseline FILE] [--early-stop]"
+       << " [--z Z]" << endl;
+  exit(1);
+}
+
+struct BenchOptions {
+  int games;
+  uint64_t seed;
+  int max_turns;
+  int block_size;
+  int threads;
+  Weights weights;
+  bool compare;
+  Weights baseline;
+  bool early_stop;
+  double z;
+};
+
+// What the games came to, by game.
+struct BenchResults {
+  vector<GameResult> games;
+  vector<GameResult> baseline_games;
+};
+
+// Plays games until game `end`, taking the next one from `next`, and writes
+// them to `results`. The time taken by every move is added to `move_seconds`.
+static void run_worker(const BenchOptions& options, int end, atomic<int>* next,
+                       BenchResults* results, vector<double>* move_seconds) {
+  int game;
+  while ((game = next->fetch_add(1)) < end) {
+    results->games[game] = play_game<DEFAULT_ROWS, DEFAULT_COLS>(
+        options.seed + game, options.max_turns, options.block_size, move_seconds,
+        options.weights);
+    if (options.compare) {
+      results->baseline_games[game] = play_game<DEFAULT_ROWS, DEFAULT_COLS>(
+          options.seed + game, options.max_turns, options.block_size, NULL,
+          options.baseline);
+    }
+  }
+}
+
+// Reads weights from a file, or the shipped weights for "shipped". Exits if
+// the file can't be read.
+static void load_weights(const char* path, Weights* weights) {
+  *weights = SHIPPED_WEIGHTS;
+  if (strcmp(path, "shipped") == 0) {
+    return;
+  }
+  ifstream in(path);
+  if (!in) {
+    cerr << "Can't open " << path << endl;
+    exit(1);
+  }
+  try {
+    read_weights(in, weights);
+  } catch (const Exception& e) {
+    cerr << path << ": " << e.what() << endl;
+    exit(1);
+  }
+}
+
+// The value below which `fraction` of the sorted `values` fall (nearest rank).
+template <typename T>
+static T percentile(const vector<T>& values, double fraction) {
+  size_t rank = (size_t)(fraction * values.size());
+  return values[min(rank, values.size() - 1)];
+}
+
+template <typename T>
+static double mean(const vector<T>& values) {
+  double total = 0;
+  for (size_t k = 0; k < values.size(); k++) {
+    total += values[k];
+  }
+  return total / values.size();
+}
+
+// Prints the mean, median and 5th percentile of `values`, sorting them.
+static void print_distribution(const char* name, vector<int>* values) {
+  sort(values->begin(), values->end());
+  printf("%-8s mean %9.1f  median %7d  p5 %7d  min %7d  max %7d\n", name, mean(*values),
+         percentile(*values, 0.5), percentile(*values, 0.05), values->front(), values->back());
+}
+
+int main(int argc, char** argv) {
+  BenchOptions options;
+  options.games = 100;
+  options.seed = 1;
+  options.max_turns = 0;
+  options.block_size = SIMULATED_BLOCK_SIZE;
+  options.threads = max(1u, thread::hardware_concurrency());
+  options.compare = false;
+  options.early_stop = false;
+  options.z = 2;
+  const char* weights_file = "shipped";
+  const char* baseline_file = NULL;
+  for (int k = 1; k < argc; k++) {
+    if (strcmp(argv[k], "--early-stop") == 0) {
+      options.early_stop = true;
+      continue;
+    }
+    if (k + 1 == argc) {
+      usage(argv[0]);
+    }
+    if (strcmp(argv[k], "--games") == 0) {
+      options.games = atoi(argv[++k]);
+    } else if (strcmp(argv[k], "--seed") == 0) {
+      options.seed = strtoull(argv[++k], NULL, 10);
+    } else if (strcmp(argv[k], "--turns") == 0) {
+      options.max_turns = atoi(argv[++k]);
+    } else if (strcmp(argv[k], "--block-size") == 0) {
+      options.block_size = atoi(argv[++k]);
+    } else if (strcmp(argv[k], "--threads") == 0) {
+      options.threads = atoi(argv[++k]);
+    } else if (strcmp(argv[k], "--weights") == 0) {
+      weights_file = argv[++k];
+    } else if (strcmp(argv[k], "--baseline") == 0) {
+      baseline_file = argv[++k];
+    } else if (strcmp(argv[k], "--z") == 0) {
+      options.z = atof(argv[++k]);
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (options.games <= 0 || options.threads <= 0 || (options.early_stop && !baseline_file)) {
+    usage(argv[0]);
+  }
+  options.threads = min(options.threads, options.games);
+  load_weights(weights_file, &options.weights);
+  if (baseline_file) {
+    options.compare = true;
+    load_weights(baseline_file, &options.baseline);
+  }
+
+  engine_debug = false;
+  typedef chrono::steady_clock Clock;
+  Clock::time_point start = Clock::now();
+  BenchResults results;
+  results.games.resize(options.games);
+  results.baseline_games.resize(options.games);
+  vector<vector<double> > worker_seconds(options.threads);
+  // With --early-stop, games are played a few per thread at a time, checking
+  // the difference in between.
+  int round = options.early_stop ? max(MIN_PAIRED_GAMES, 2 * options.threads) : options.games;
+  int played = 0;
+  vector<int> scores, baseline_scores;
+  PairedDifference difference = {0, 0, 0};
+  while (played < options.games) {
+    int end = min(played + round, options.games);
+    atomic<int> next(played);
+    vector<thread> workers;
+    for (int k = 0; k < options.threads; k++) {
+      workers.push_back(thread(run_worker, cref(options), end, &next, &results,
+                               &worker_seconds[k]));
+    }
+    for (int k = 0; k < options.threads; k++) {
+      workers[k].join();
+    }
+    for (int game = played; game < end; game++) {
+      scores.push_back(results.games[game].score);
+      baseline_scores.push_back(results.baseline_games[game].score);
+    }
+    played = end;
+    if (options.compare) {
+      difference = paired_difference(scores.data(), baseline_scores.data(), played);
+      if (options.early_stop && significant(difference, options.z)) {
+        break;
+      }
+    }
+  }
+  double elapsed = chrono::duration<double>(Clock::now() - start).count();
+
+  vector<int> lines, turns;
+  vector<double> move_seconds;
+  int illegal_commands = 0;
+  for (int game = 0; game < played; game++) {
+    lines.push_back(results.games[game].lines);
+    turns.push_back(results.games[game].turns);
+    illegal_commands += results.games[game].illegal_commands;
+  }
+  for (int k = 0; k < options.threads; k++) {
+    move_seconds.insert(move_seconds.end(), worker_seconds[k].begin(), worker_seconds[k].end());
+  }
+
+  long total_lines = 0;
+  for (size_t k = 0; k < lines.size(); k++) {
+    total_lines += lines[k];
+  }
+  printf("%d games from seed %llu, blocks of up to %d squares, %d threads, %s weights\n",
+         played, (unsigned long long)options.seed, options.block_size, options.threads,
+         weights_file);
+  print_distribution("score", &scores);
+  print_distribution("lines", &lines);
+  print_distribution("turns", &turns);
+  if (!move_seconds.empty()) {
+    sort(move_seconds.begin(), move_seconds.end());
+    printf("move us  mean %9.1f  p50 %7.1f  p90 %7.1f  p99 %7.1f  max %7.1f\n",
+           1e6 * mean(move_seconds), 1e6 * percentile(move_seconds, 0.5),
+           1e6 * percentile(move_seconds, 0.9), 1e6 * percentile(move_seconds, 0.99),
+           1e6 * move_seconds.back());
+  }
+  printf("%.2fs: %.0f moves/s, %.0f lines/s\n", elapsed,
+         elapsed > 0 ? move_seconds.size() / elapsed : 0.0,
+         elapsed > 0 ? total_lines / elapsed : 0.0);
+  if (options.compare) {
+    print_distribution("baseline", &baseline_scores);
+    printf("score difference from %s: %+.2f +/- %.2f (%s at z = %.1f)\n", baseline_file,
+           difference.mean, difference.standard_error,
+           significant(difference, options.z) ? "significant" : "not significant", options.z);
+  }
+  if (illegal_commands) {
+    printf("%d illegal commands skipped\n", illegal_commands);
+  }
+  return 0;
+}
@@ -0,0 +1,42 @@
+// Converts game states between the JSON the server sends and the binary
+// format from state_binary.h. The input format is detected automatically.
+//
+//   convert_state [--json] <state JSON | - | @state-file>
+//
+// writes the binary encoding to stdout, or JSON with --json.
+
+#include "dropblox_ai.h"
+#include "state_binary.h"
+#include "state_input.h"
+#include "state_json.h"
+#include "state_parser.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+int main(int argc, char** argv) {
+  bool to_json = argc == 3 && strcmp(argv[1], "--json") == 0;
+  if (argc != 2 && !to_json) {
+    cerr << "Usage: " << argv[0] << " [--json] <state JSON | - | @state-file>" << endl;
+    return 1;
+  }
+
+  StateInput input(argv[argc - 1]);
+  GameState state;
+  if (is_binary_state(input.begin(), input.end())) {
+    parse_binary_state(input.begin(), input.end(), &state);
+  } else {
+    parse_game_state(input.begin(), input.end(), &state);
+  }
+
+  if (to_json) {
+    write_json_state(state, cout);
+  } else {
+    string out;
+    write_binary_state(state, &out);
+    fwrite(out.data(), 1, out.size(), stdout);
+  }
+  return 0;
+}
@@ -0,0 +1,775 @@
+// Checks the engine's fast paths against the plain versions in reference.h,
+// on recorded states and on fuzzed boards.
+//
+//   difftest [--fuzz N] [--seed S] [CORPUS...]
+//   difftest --record FILE
+//
+// For every state it compares, exactly:
+//
+//   check                  against reference_check, at every translation
+//                          near the board and every rotation
+//   generate_placements    against reference_placements
+//   place_into             against reference_place: the bitmap, its row
+//                          masks, the rows removed, where the block landed
+//                          and the next block
+//   remove_rows            against reference_remove_rows, with full rows
+//                          added to the board
+//   evaluate_batch         features and scores against the scalar get_*
+//                          functions, with the shipped and random weights,
+//                          and with reduced feature masks against every
+//                          feature with the other weights zeroed
+//   count_*, top_k         the staged evaluator, likewise
+//   board_hash             placements that pick_move merges, against the
+//                          boards they land on
+//   calc_score, pick_move  against reference_pick_move
+//   number limits          parse_game_state on numbers that overflow
+//
+// Each line of a corpus is a state in the server's JSON format. A state is
+// also parsed by the Cajun reader and through the binary format, and the
+// three must agree, and a corrupt rotation byte in the binary encoding
+// must be rejected. If the state has a "moves" member, which is read with
+// the Cajun reader's streaming Handler interface, pick_move must still pick
+// those moves. --fuzz plays N random boards (default 500) for every
+// geometry, with random stacks, full rows, catalog blocks and random
+// polyominoes, some too big for a shape table.
+//
+// --record writes a corpus of states from seeded self-play on every
+// geometry, with the moves pick_move picks, once the reference agrees with
+// them. golden_states.jsonl was made this way; `make check` runs the test on
+// it.
+//
+// Prints how many comparisons of each kind were made, and exits with status
+// 1 if any of them differed.
+
+#include "dropblox_ai.h"
+#include "batch_evaluator.h"
+#include "engine.h"
+#include "evaluator.h"
+#include "reference.h"
+#include "simulator.h"
+#include "staged_evaluator.h"
+#include "state_binary.h"
+#include "state_input.h"
+#include "state_json.h"
+#include "state_parser.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+using namespace std;
+
+// The failures printed before the rest are only counted.
+#define MAX_PRINTED_FAILURES 20
+
+// How many of the best boards the staged evaluator is asked for.
+#define TOP_K 3
+
+static void usage(const char* name) {
+  cerr << "Usage: " << name << " [--fuzz N] [--seed S] [CORPUS...]" << endl
+       << "       " << name << " --record FILE" << endl;
+  exit(1);
+}
+
+// Counts the comparisons made, and prints the first few that failed.
+class Report {
+ public:
+  Report() : failures(0) {}
+
+  // Records a comparison of `what`, which came out the same or not. The
+  // placement, if given, says where on the board it was.
+  void expect(bool same, const char* what, const string& where,
+              const Placement* placement = NULL) {
+    counts[what]++;
+    if (same) {
+      return;
+    }
+    if (failures < MAX_PRINTED_FAILURES) {
+      cerr << where << ": " << what << " differs";
+      if (placement) {
+        cerr << " at rotation " << placement->rotation << ", translation "
+             << placement->translation;
+      }
+      cerr << endl;
+    }
+    failures++;
+  }
+
+  long get_failures() const { return failures; }
+
+  void print() const {
+    for (map<string, long>::const_iterator it = counts.begin(); it != counts.end(); ++it) {
+      printf("%-24s %10ld compared\n", it->first.c_str(), it->second);
+    }
+    if (failures) {
+      printf("%ld differed\n", failures);
+    } else {
+      printf("All the same\n");
+    }
+  }
+
+ private:
+  map<string, long> counts;
+  long failures;
+};
+
+static void free_blocks(GameState* state) {
+  delete state->block;
+  for (size_t k = 0; k < state->preview.size(); k++) {
+    delete state->preview[k];
+  }
+  state->block = NULL;
+  state->preview.clear();
+}
+
+static bool same_block(const Block* a, const Block* b) {
+  if (!a || !b) {
+    return a == b;
+  }
+  if (a->center.i != b->center.i || a->center.j != b->center.j || a->size != b->size ||
+      a->has_shape_table != b->has_shape_table || a->shape_id != b->shape_id) {
+    return false;
+  }
+  for (int k = 0; k < a->size; k++) {
+    if (a->offsets[k].i != b->offsets[k].i || a->offsets[k].j != b->offsets[k].j) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool same_placements(const vector<Placement>& a, const vector<Placement>& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t k = 0; k < a.size(); k++) {
+    if (a[k].rotation != b[k].rotation || a[k].translation != b[k].translation) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool same_features(const int* a, const int* b) {
+  return memcmp(a, b, NUM_FEATURES * sizeof(int)) == 0;
+}
+
+template <int ROWS, int COLS>
+bool same_bitmap(const BasicBoard<ROWS, COLS>& a, const BasicBoard<ROWS, COLS>& b) {
+  for (int i = 0; i < ROWS; i++) {
+    for (int j = 0; j < COLS; j++) {
+      if (a.bitmap[i][j] != b.bitmap[i][j]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Whether the board's row masks say what its bitmap says.
+template <int ROWS, int COLS>
+bool masks_match_bitmap(const BasicBoard<ROWS, COLS>& board) {
+  for (int i = 0; i < ROWS; i++) {
+    uint64_t mask = 0;
+    for (int j = 0; j < COLS; j++) {
+      mask |= (uint64_t)(board.bitmap[i][j] != 0) << j;
+    }
+    if (board.row_masks[i] != mask) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// A number in [0, 1).
+static double uniform(SimRandom* rng) {
+  return (rng->next() >> 11) * (1.0 / (1ULL << 53));
+}
+
+// Weights in [-2, 2), some of them 0.
+static Weights random_weights(SimRandom* rng) {
+  Weights weights;
+  for (int f = 0; f < NUM_FEATURES; f++) {
+    weights.weights[f] = rng->below(8) ? 4 * uniform(rng) - 2 : 0;
+  }
+  return weights;
+}
+
+// Scores the boards with only the features in FEATURES, and with every
+// feature but the weights of the others zeroed, which must come out the
+// same. The features outside the mask must be left alone.
+template <unsigned FEATURES, int ROWS, int COLS>
+void compare_mask(const vector<Placement>& placements,
+                  const vector<BasicPackedBoard<ROWS, COLS> >& packed,
+                  const vector<int>& reference_features, const Weights& weights,
+                  const string& where, Report* report) {
+  Weights zeroed = weights;
+  for (int f = 0; f < NUM_FEATURES; f++) {
+    if (!(FEATURES & FEATURE_BIT(f))) {
+      zeroed.weights[f] = 0;
+    }
+  }
+  size_t n = placements.size();
+  vector<float> full(n);
+  evaluate_batch<ALL_FEATURES>(packed.data(), n, full.data(), zeroed);
+  vector<float> masked(n);
+  vector<int> features(n * NUM_FEATURES, -1);
+  evaluate_batch<FEATURES>(packed.data(), n, masked.data(), zeroed, features.data());
+  for (size_t p = 0; p < n; p++) {
+    bool same = masked[p] == full[p];
+    for (int f = 0; f < NUM_FEATURES; f++) {
+      int expected = FEATURES & FEATURE_BIT(f) ? reference_features[p * NUM_FEATURES + f] : -1;
+      same = same && features[p * NUM_FEATURES + f] == expected;
+    }
+    report->expect(same, "evaluate_batch masks", where, &placements[p]);
+  }
+}
+
+// Scores the boards a block lands on from each of `placements`, with
+// `weights`, and compares them all with the reference.
+template <int ROWS, int COLS>
+void compare_scores(const vector<Placement>& placements,
+                    const vector<BasicBoard<ROWS, COLS> >& landed,
+                    const vector<BasicPackedBoard<ROWS, COLS> >& packed,
+                    const vector<int>& reference_features, const Weights& weights,
+                    const string& where, Report* report) {
+  size_t n = placements.size();
+  RuntimeEvaluator evaluator(weights);
+  vector<float> reference_scores(n);
+  for (size_t p = 0; p < n; p++) {
+    int values[NUM_FEATURES];
+    reference_scores[p] = evaluator.score(landed[p], packed[p].landing_height,
+                                          packed[p].rows_removed, values);
+  }
+
+  vector<float> scores(n);
+  vector<int> features(n * NUM_FEATURES);
+  evaluate_batch(packed.data(), n, scores.data(), weights, features.data());
+  for (size_t p = 0; p < n; p++) {
+    report->expect(same_features(&features[p * NUM_FEATURES],
+                                 &reference_features[p * NUM_FEATURES]),
+                   "evaluate_batch features", where, &placements[p]);
+    report->expect(scores[p] == reference_scores[p], "evaluate_batch score", where,
+                   &placements[p]);
+  }
+  compare_mask<SHIPPED_FEATURES>(placements, packed, reference_features, weights, where, report);
+  compare_mask<FEATURE_BIT(HOLES)>(placements, packed, reference_features, weights, where,
+                                   report);
+  compare_mask<ALL_FEATURES & ~FEATURE_BIT(COL_TRANSITIONS)>(placements, packed,
+                                                             reference_features, weights,
+                                                             where, report);
+  compare_mask<FEATURE_BIT(LANDING_HEIGHT) | FEATURE_BIT(ROW_TRANSITIONS) |
+               FEATURE_BIT(WELL_SUMS)>(placements, packed, reference_features, weights, where,
+                                       report);
+  compare_mask<FEATURE_BIT(COL_TRANSITIONS) | FEATURE_BIT(POINTS_EARNED)>(
+      placements, packed, reference_features, weights, where, report);
+
+  // The best TOP_K, best first, ties in placement order.
+  vector<int> order(n);
+  for (size_t p = 0; p < n; p++) {
+    order[p] = (int)p;
+  }
+  stable_sort(order.begin(), order.end(), [&](int a, int b) {
+    return reference_scores[a] > reference_scores[b];
+  });
+  StagedEvaluator<ROWS, COLS> staged(weights);
+  int best[TOP_K];
+  float best_scores[TOP_K];
+  int count = staged.top_k(packed.data(), n, TOP_K, best, best_scores);
+  bool same = count == (int)min(n, (size_t)TOP_K);
+  for (int k = 0; same && k < count; k++) {
+    same = best[k] == order[k] && best_scores[k] == reference_scores[order[k]];
+  }
+  report->expect(same, "top_k", where);
+}
+
+// Compares everything the engine does with the board against the reference.
+template <int ROWS, int COLS>
+void compare_board(const BasicBoard<ROWS, COLS>& board, SimRandom* rng, const string& where,
+                   Report* report) {
+  const Block& block = *board.block;
+  BasicBoard<ROWS, COLS> result;
+  BasicBoard<ROWS, COLS> reference_result;
+  Point landing;
+  Point reference_landing;
+
+  // Every translation that puts the block on or near the board, and from a
+  // few of the valid ones, a drop.
+  for (int rotation = 0; rotation < 4; rotation++) {
+    for (int i = -2; i <= ROWS; i++) {
+      for (int j = -COLS; j <= COLS; j++) {
+        Point translation = {i, j};
+        bool valid = reference_check(board, block, translation, rotation);
+        Placement placement = {rotation, j};
+        report->expect(board.check(block, translation, rotation) == valid, "check", where,
+                       &placement);
+        if (valid && rng->below(8) == 0) {
+          int rows = board.place_into(block, translation, rotation, &result, &landing);
+          int reference_rows = reference_place(board, translation, rotation, &reference_result,
+                                               &reference_landing);
+          report->expect(rows == reference_rows && landing.i == reference_landing.i &&
+                         landing.j == reference_landing.j &&
+                         same_bitmap(result, reference_result),
+                         "place_into", where, &placement);
+        }
+      }
+    }
+  }
+
+  vector<Placement> placements;
+  vector<Placement> reference;
+  generate_placements(board, &placements);
+  reference_placements(board, &reference);
+  report->expect(same_placements(placements, reference), "generate_placements", where);
+
+  size_t n = reference.size();
+  vector<BasicBoard<ROWS, COLS> > landed(n);
+  vector<BasicPackedBoard<ROWS, COLS> > packed(n);
+  vector<int> reference_features(n * NUM_FEATURES);
+  Block* next = board.preview.size() > 0 ? board.preview[0] : NULL;
+  for (size_t p = 0; p < n; p++) {
+    Point translation = {0, reference[p].translation};
+    int rows = board.place_into(block, translation, reference[p].rotation, &result, &landing);
+    int reference_rows = reference_place(board, translation, reference[p].rotation, &landed[p],
+                                         &reference_landing);
+    landed[p].update_row_masks();
+    report->expect(rows == reference_rows && landing.i == reference_landing.i &&
+                   landing.j == reference_landing.j && same_bitmap(result, landed[p]) &&
+                   masks_match_bitmap(result) && result.block == next,
+                   "place_into", where, &reference[p]);
+
+    int landing_height = block.center.i + reference_landing.i;
+    int* values = &reference_features[p * NUM_FEATURES];
+    compute_features<ALL_FEATURES>(landed[p], landing_height, reference_rows, values);
+    pack_board(landed[p], landing_height, reference_rows, &packed[p]);
+    report->expect(count_holes(packed[p]) == values[HOLES] &&
+                   count_row_transitions(packed[p]) == values[ROW_TRANSITIONS] &&
+                   count_col_transitions(packed[p]) == values[COL_TRANSITIONS] &&
+                   count_well_sum(packed[p]) == values[WELL_SUMS],
+                   "count_* features", where, &reference[p]);
+
+    float score = calc_score(board, translation, reference[p].rotation, &result);
+    report->expect(score == ShippedEvaluator(SHIPPED_WEIGHTS).score(landed[p], landing_height,
+                                                                    reference_rows),
+                   "calc_score", where, &reference[p]);
+  }
+
+  // The board with a few more rows filled, emptied by each remove_rows.
+  BasicBoard<ROWS, COLS> full = board;
+  int fill = 1 + rng->below(4);
+  for (int k = 0; k < fill; k++) {
+    int i = rng->below(ROWS);
+    for (int j = 0; j < COLS; j++) {
+      full.bitmap[i][j] = 1;
+    }
+  }
+  reference_result = full;
+  int removed = BasicBoard<ROWS, COLS>::remove_rows(&full.bitmap);
+  int reference_removed = reference_remove_rows<ROWS, COLS>(reference_result.bitmap);
+  report->expect(removed == reference_removed && same_bitmap(full, reference_result),
+                 "remove_rows", where);
+
+  Weights weights = random_weights(rng);
+  compare_scores(reference, landed, packed, reference_features, SHIPPED_WEIGHTS, where,
+                 report);
+  compare_scores(reference, landed, packed, reference_features, weights, where, report);
+
+  // pick_move scores placements that hash alike once, so they must have
+  // landed on the same board.
+  for (size_t p = 0; p < n; p++) {
+    uint64_t hash = board_hash(packed[p]);
+    for (size_t q = 0; q < p; q++) {
+      if (board_hash(packed[q]) == hash) {
+        report->expect(same_features(&reference_features[p * NUM_FEATURES],
+                                     &reference_features[q * NUM_FEATURES]) &&
+                       same_bitmap(landed[p], landed[q]),
+                       "board_hash", where, &reference[p]);
+      }
+    }
+  }
+
+  vector<string> moves = reference_pick_move(board);
+  MoveScratch<ROWS, COLS> scratch;
+  report->expect(pick_move(board, &scratch) == moves, "pick_move", where);
+  // Again, with the scratch already used.
+  report->expect(pick_move(board, &scratch) == moves, "pick_move", where);
+  report->expect(pick_move(board, &scratch, weights) == reference_pick_move(board, weights),
+                 "pick_move weights", where);
+}
+
+// A block for a fuzzed board: usually a catalog shape where the server
+// would spawn it, otherwise a random polyomino of up to 20 squares, turning
+// about a random one of them, at the top of the board.
+template <int COLS>
+Block* random_block(SimRandom* rng) {
+  if (rng->below(4)) {
+    return spawn_block<COLS>(rng->below(CATALOG_SIZE));
+  }
+  int size = 1 + rng->below(20);
+  vector<Point> cells(1, Point{0, 0});
+  while ((int)cells.size() < size) {
+    Point cell = cells[rng->below((int)cells.size())];
+    int step = rng->below(4);
+    cell.i += step == 0 ? 1 : step == 1 ? -1 : 0;
+    cell.j += step == 2 ? 1 : step == 3 ? -1 : 0;
+    bool taken = false;
+    for (size_t k = 0; k < cells.size(); k++) {
+      taken = taken || (cells[k].i == cell.i && cells[k].j == cell.j);
+    }
+    if (!taken) {
+      cells.push_back(cell);
+    }
+  }
+  Point pivot = cells[rng->below(size)];
+  vector<Point> offsets(size);
+  int min_i = 0;
+  int min_j = 0;
+  int max_j = 0;
+  for (int k = 0; k < size; k++) {
+    offsets[k].i = cells[k].i - pivot.i;
+    offsets[k].j = cells[k].j - pivot.j;
+    min_i = min(min_i, offsets[k].i);
+    min_j = min(min_j, offsets[k].j);
+    max_j = max(max_j, offsets[k].j);
+  }
+  int room = COLS - (max_j - min_j + 1);
+  Point center = {-min_i, -min_j + rng->below(max(room, 0) + 1)};
+  return new Block(center, offsets);
+}
+
+// Fills `state` with a random board: a ragged stack with holes, sometimes
+// with noise above it or full rows in it, and a random block and preview.
+template <int ROWS, int COLS>
+void fuzz_state(SimRandom* rng, GameState* state) {
+  const uint64_t FULL = ~(uint64_t)0 >> (64 - COLS);
+  state->rows = ROWS;
+  state->cols = COLS;
+  int top = rng->below(ROWS);
+  for (int i = 0; i < ROWS; i++) {
+    state->row_masks[i] = 0;
+  }
+  for (int j = 0; j < COLS; j++) {
+    int height = rng->below(top + 1);
+    for (int i = ROWS - height; i < ROWS; i++) {
+      if (rng->below(8)) {
+        state->row_masks[i] |= (uint64_t)1 << j;
+      }
+    }
+  }
+  if (rng->below(4) == 0) {
+    for (int i = ROWS - top; i < ROWS; i++) {
+      state->row_masks[i] |= rng->next() & rng->next() & FULL;
+    }
+  }
+  if (rng->below(4) == 0 && top > 0) {
+    state->row_masks[ROWS - 1 - rng->below(top)] = FULL;
+  }
+  state->block = random_block<COLS>(rng);
+  int previews = rng->below(PREVIEW_SIZE + 1);
+  for (int k = 0; k < previews; k++) {
+    state->preview.push_back(spawn_block<COLS>(rng->below(CATALOG_SIZE)));
+  }
+}
+
+template <int ROWS, int COLS>
+void fuzz(int boards, uint64_t seed, Report* report) {
+  SimRandom rng(seed ^ ((uint64_t)ROWS << 32 | COLS));
+  for (int b = 0; b < boards; b++) {
+    GameState state;
+    fuzz_state<ROWS, COLS>(&rng, &state);
+    BasicBoard<ROWS, COLS> board(state.row_masks, state.block, Preview(&state.preview, 0));
+    ostringstream where;
+    where << "fuzzed " << ROWS << "x" << COLS << " board " << b;
+    compare_board(board, &rng, where.str(), report);
+    free_blocks(&state);
+  }
+}
+
+static bool same_state(const GameState& a, const GameState& b) {
+  if (a.rows != b.rows || a.cols != b.cols || a.preview.size() != b.preview.size() ||
+      !same_block(a.block, b.block)) {
+    return false;
+  }
+  for (int i = 0; i < a.rows; i++) {
+    if (a.row_masks[i] != b.row_masks[i]) {
+      return false;
+    }
+  }
+  for (size_t k = 0; k < a.preview.size(); k++) {
+    if (!same_block(a.preview[k], b.preview[k])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Rewrites the rotation byte of the state's block in its binary encoding.
+// Rotations 0 to 3 must decode, and anything else must be rejected rather
+// than masked.
+static void check_binary_rotation(const GameState& state, const string& binary,
+                                  const string& where, Report* report) {
+  size_t block = 8 + state.rows * ((state.cols + 7) / 8);
+  if ((unsigned char)binary[block + 2] == BINARY_CUSTOM_SHAPE) {
+    return;
+  }
+  const int rotations[] = {0, 1, 2, 3, 4, 0x80, 0xff};
+  for (size_t k = 0; k < sizeof rotations / sizeof *rotations; k++) {
+    string corrupt = binary;
+    corrupt[block + 3] = (char)rotations[k];
+    GameState decoded;
+    bool rejected = false;
+    try {
+      parse_binary_state(corrupt.data(), corrupt.data() + corrupt.size(), &decoded);
+    } catch (const Exception&) {
+      rejected = true;
+    }
+    free_blocks(&decoded);
+    report->expect(rejected == (rotations[k] > 3), "binary rotation", where);
+  }
+}
+
+// Compares the fast parser with the Cajun reader the engine used to build
+// its board with, which needs a full preview.
+template <int ROWS, int COLS>
+void compare_parsers(const GameState& state, Object& object, const string& where,
+                     Report* report) {
+  if (state.preview.size() < PREVIEW_SIZE) {
+    return;
+  }
+  BasicBoard<ROWS, COLS> board(state.row_masks, state.block, Preview(&state.preview, 0));
+  // These blocks are never freed; see the constructor.
+  BasicBoard<ROWS, COLS> cajun(object);
+  bool same = same_bitmap(board, cajun) && same_block(board.block, cajun.block);
+  for (int k = 0; same && k < PREVIEW_SIZE; k++) {
+    same = same_block(board.preview[k], cajun.preview[k]);
+  }
+  report->expect(same, "parse_game_state", where);
+}
+
+// Collects the "moves" member of a state as the reader streams past it, and
+// stops reading once it has them.
+class RecordedMovesHandler : public Reader::Handler {
+ public:
+  RecordedMovesHandler() : found(false), depth_(0), in_moves_(false) {}
+
+  bool found;
+  vector<string> moves;
+
+  virtual void BeginObject() { depth_++; }
+  virtual void EndObject() { depth_--; }
+  virtual void MemberName(const string& name) {
+    if (depth_ == 1) {
+      member_ = name;
+    }
+  }
+  virtual void BeginArray() {
+    if (depth_ == 1 && member_ == "moves") {
+      found = in_moves_ = true;
+    }
+    depth_++;
+  }
+  virtual void EndArray() {
+    depth_--;
+    if (in_moves_ && depth_ == 1) {
+      Stop();
+    }
+  }
+  virtual void StringValue(const string& value) {
+    if (in_moves_ && depth_ == 2) {
+      moves.push_back(value);
+    }
+  }
+
+ private:
+  int depth_;
+  string member_;
+  bool in_moves_;
+};
+
+template <int ROWS, int COLS>
+void compare_state(const GameState& state, Object& object, const RecordedMovesHandler& recorded,
+                   SimRandom* rng, const string& where, Report* report) {
+  compare_parsers<ROWS, COLS>(state, object, where, report);
+  BasicBoard<ROWS, COLS> board(state.row_masks, state.block, Preview(&state.preview, 0));
+  compare_board(board, rng, where, report);
+
+  if (recorded.found) {
+    MoveScratch<ROWS, COLS> scratch;
+    report->expect(pick_move(board, &scratch) == recorded.moves, "recorded moves", where);
+  }
+}
+
+// Compares every state in a corpus. Returns false if it can't be read.
+static bool compare_corpus(const char* path, SimRandom* rng, Report* report) {
+  ifstream in(path);
+  if (!in) {
+    cerr << "Can't read " << path << endl;
+    return false;
+  }
+  string line;
+  int number = 0;
+  while (getline(in, line)) {
+    number++;
+    if (line.find_first_not_of(" \t\r") == string::npos) {
+      continue;
+    }
+    ostringstream where;
+    where << path << ":" << number;
+    GameState state;
+    try {
+      parse_game_state(line.data(), line.data() + line.size(), &state);
+      Object object;
+      istringstream text(line);
+      Reader::Read(object, text);
+      RecordedMovesHandler recorded;
+      istringstream moves_text(line);
+      Reader::Read(recorded, moves_text);
+
+      string binary;
+      write_binary_state(state, &binary);
+      GameState decoded;
+      parse_binary_state(binary.data(), binary.data() + binary.size(), &decoded);
+      report->expect(same_state(state, decoded), "binary round trip", where.str());
+      free_blocks(&decoded);
+      check_binary_rotation(state, binary, where.str(), report);
+
+      bool supported = false;
+#define COMPARE_GEOMETRY(R, C) \
+      if (state.rows == R && state.cols == C) { \
+        compare_state<R, C>(state, object, recorded, rng, where.str(), report); \
+        supported = true; \
+      }
+      FOR_EACH_GEOMETRY(COMPARE_GEOMETRY)
+#undef COMPARE_GEOMETRY
+      if (!supported) {
+        cerr << where.str() << ": unsupported board geometry " << state.rows << "x"
+             << state.cols << endl;
+        free_blocks(&state);
+        return false;
+      }
+    } catch (const Exception& e) {
+      cerr << where.str() << ": " << e.what() << endl;
+      free_blocks(&state);
+      return false;
+    }
+    free_blocks(&state);
+  }
+  return true;
+}
+
+// Checks that parse_game_state reads numbers with extreme exponents as the
+// nearest double, and rejects integers that don't fit an int, rather than
+// overflowing.
+static void check_numbers(Report* report) {
+  struct {
+    const char* number;
+    int filled;  // -1 if the state must be rejected
+  } cases[] = {
+      {"1", 1},
+      {"0.5e1", 1},
+      {"123456e-3", 1},
+      {"1e-99999999999999999999", 0},
+      {"0e99999999999999999999", 0},
+      {"1e99999999999999999999", -1},
+      {"-1e10", -1},
+      {"4e9", -1},
+  };
+  for (size_t k = 0; k < sizeof cases / sizeof *cases; k++) {
+    // Ignored members are read as numbers too.
+    string text = string("{\"bitmap\": [[") + cases[k].number + ", 0]], \"block\": {\"center\": "
+                  "{\"i\": 0, \"j\": 1}, \"offsets\": [{\"i\": 0, \"j\": 0}]}, \"preview\": [], "
+                  "\"ignored\": -1e99999999999999999999}";
+    GameState state;
+    int filled = -1;
+    try {
+      parse_game_state(text.data(), text.data() + text.size(), &state);
+      filled = (int)(state.row_masks[0] & 1);
+    } catch (const Exception&) {
+    }
+    free_blocks(&state);
+    report->expect(filled == cases[k].filled, "number limits", cases[k].number);
+  }
+}
+
+// Appends states from self-play on one geometry to `out`, each with the
+// moves pick_move picks for it. Returns false if the reference picks
+// different ones.
+template <int ROWS, int COLS>
+bool record(ostream& out) {
+  vector<string> states;
+  record_states<ROWS, COLS>(1, 2, 10, 200, SIMULATED_BLOCK_SIZE, &states);
+  for (size_t s = 0; s < states.size(); s++) {
+    GameState state;
+    parse_game_state(states[s].data(), states[s].data() + states[s].size(), &state);
+    BasicBoard<ROWS, COLS> board(state.row_masks, state.block, Preview(&state.preview, 0));
+    MoveScratch<ROWS, COLS> scratch;
+    vector<string> moves = pick_move(board, &scratch);
+    if (moves != reference_pick_move(board)) {
+      cerr << "pick_move and the reference differ on a " << ROWS << "x" << COLS << " state"
+           << endl;
+      free_blocks(&state);
+      return false;
+    }
+    string members = ", \"moves\": [";
+    for (size_t k = 0; k < moves.size(); k++) {
+      members += (k ? ", \"" : "\"") + moves[k] + "\"";
+    }
+    write_json_state(state, out, members + "]");
+    free_blocks(&state);
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  int boards = 500;
+  uint64_t seed = 1;
+  const char* record_path = NULL;
+  vector<const char*> corpora;
+  for (int k = 1; k < argc; k++) {
+    if (strcmp(argv[k], "--fuzz") == 0 && k + 1 < argc) {
+      boards = atoi(argv[++k]);
+    } else if (strcmp(argv[k], "--seed") == 0 && k + 1 < argc) {
+      seed = strtoull(argv[++k], NULL, 10);
+    } else if (strcmp(argv[k], "--record") == 0 && k + 1 < argc) {
+      record_path = argv[++k];
+    } else if (argv[k][0] == '-') {
+      usage(argv[0]);
+    } else {
+      corpora.push_back(argv[k]);
+    }
+  }
+
+  engine_debug = false;
+  if (record_path) {
+    ofstream out(record_path);
+    bool recorded = true;
+#define RECORD_GEOMETRY(R, C) recorded = recorded && record<R, C>(out);
+    FOR_EACH_GEOMETRY(RECORD_GEOMETRY)
+#undef RECORD_GEOMETRY
+    if (!recorded || !out) {
+      cerr << "Couldn't record " << record_path << endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  Report report;
+  SimRandom rng(seed);
+  check_numbers(&report);
+  for (size_t k = 0; k < corpora.size(); k++) {
+    if (!compare_corpus(corpora[k], &rng, &report)) {
+      return 1;
+    }
+  }
+#define FUZZ_GEOMETRY(R, C) fuzz<R, C>(boards, seed, &report);
+  FOR_EACH_GEOMETRY(FUZZ_GEOMETRY)
+#undef FUZZ_GEOMETRY
+
+  report.print();
+  return report.get_failures() ? 1 : 0;
+}
@@ -1,4 +1,7 @@
 #include "dropblox_ai.h"
+#include "batch_evaluator.h"
+#include "engine.h"
+#include "evaluator.h"
 #include "float.h"
 
 using namespace json;
@@ -11,16 +14,29 @@ using namespace std;
 Block::Block(Object& raw_block) {
   center.i = (int)(Number&)raw_block["center"]["i"];
   center.j = (int)(Number&)raw_block["center"]["j"];
-  size = 0;
-
   Array& raw_offsets = raw_block["offsets"];
-  for (Array::const_iterator it = raw_offsets.Begin(); it < raw_offsets.End(); it++) {
-    size += 1;
-  }
+  size = raw_offsets.Size();
+  offsets.resize(size);
   for (int i = 0; i < size; i++) {
     offsets[i].i = (Number&)raw_offsets[i]["i"];
     offsets[i].j = (Number&)raw_offsets[i]["j"];
   }
+  init();
+}
+
+Block::Block(const Point& center, const vector<Point>& offsets)
+    : center(center), size(offsets.size()), offsets(offsets) {
+  init();
+}
+
+void Block::init() {
+  vector<ShapeCell> cells(size);
+  for (int i = 0; i < size; i++) {
+    cells[i].i = offsets[i].i;
+    cells[i].j = offsets[i].j;
+  }
+  has_shape_table = shape_fits(cells.data(), size);
+  shape_id = has_shape_table ? build_shape_table(cells.data(), size, &shape) : NO_SHAPE;
 
   translation.i = 0;
   translation.j = 0;
@@ -56,7 +72,8 @@ void Block::unrotate() {
 // return true if the move succeeded.
 //
 // The block is still assumed to start in a legal position.
-bool Block::checked_left(const Board& board) {
+template <typename BoardT>
+bool Block::checked_left(const BoardT& board) {
   left();
   if (board.check(*this)) {
     return true;
@@ -65,7 +82,8 @@ bool Block::checked_left(const Board& board) {
   return false;
 }
 
-bool Block::checked_right(const Board& board) {
+template <typename BoardT>
+bool Block::checked_right(const BoardT& board) {
   right();
   if (board.check(*this)) {
     return true;
@@ -74,7 +92,8 @@ bool Block::checked_right(const Board& board) {
   return false;
 }
 
-bool Block::checked_up(const Board& board) {
+template <typename BoardT>
+bool Block::checked_up(const BoardT& board) {
   up();
   if (board.check(*this)) {
     return true;
@@ -83,7 +102,8 @@ bool Block::checked_up(const Board& board) {
   return false;
 }
 
-bool Block::checked_down(const Board& board) {
+template <typename BoardT>
+bool Block::checked_down(const BoardT& board) {
   down();
   if (board.check(*this)) {
     return true;
@@ -92,7 +112,8 @@ bool Block::checked_down(const Board& board) {
   return false;
 }
 
-bool Block::checked_rotate(const Board& board) {
+template <typename BoardT>
+bool Block::checked_rotate(const BoardT& board) {
   rotate();
   if (board.check(*this)) {
     return true;
@@ -133,15 +154,12 @@ void Block::reset_position() {
 // Board implementation starts here!
 //----------------------------------
 
-Board::Board() {
-  rows = ROWS;
-  cols = COLS;
+template <int ROWS, int COLS>
+BasicBoard<ROWS, COLS>::BasicBoard() {
 }
 
-Board::Board(Object& state) {
-  rows = ROWS;
-  cols = COLS;
-
+template <int ROWS, int COLS>
+BasicBoard<ROWS, COLS>::BasicBoard(Object& state) {
   for (int i = 0; i < ROWS; i++) {
     for (int j = 0; j < COLS; j++) {
       bitmap[i][j] = ((int)(Number&)state["bitmap"][i][j] ? 1 : 0);
@@ -154,25 +172,72 @@ Board::Board(Object& state) {
   // There's a memory leak here, but it's okay: blocks are only constructed
   // when you construct a board from a JSON Object, which should only happen
   // for the very first board. The total memory leaked will only be ~10 kb.
+  // The same goes for the preview sequence, which every descendant board
+  // shares.
   block = new Block(state["block"]);
+  vector<Block*>* blocks = new vector<Block*>();
+  blocks->reserve(PREVIEW_SIZE);
   for (int i = 0; i < PREVIEW_SIZE; i++) {
-    preview.push_back(new Block(state["preview"][i]));
+    blocks->push_back(new Block(state["preview"][i]));
+  }
+  preview = Preview(blocks, 0);
+  update_row_masks();
+}
+
+// As above, the blocks and the preview sequence live for the rest of the
+// process.
+template <int ROWS, int COLS>
+BasicBoard<ROWS, COLS>::BasicBoard(const GameState& state)
+    : BasicBoard(state.row_masks, state.block, Preview(new vector<Block*>(state.preview), 0)) {
+}
+
+template <int ROWS, int COLS>
+BasicBoard<ROWS, COLS>::BasicBoard(const uint64_t* masks, Block* block, const Preview& preview)
+    : block(block), preview(preview) {
+  for (int i = 0; i < ROWS; i++) {
+    for (int j = 0; j < COLS; j++) {
+      bitmap[i][j] = (masks[i] >> j) & 1;
+    }
+    row_masks[i] = (RowMask)masks[i];
   }
 }
 
 // Returns true if the `query` block is in valid position - that is, if all of
 // its squares are in bounds and are currently unoccupied.
-bool Board::check(const Block& query) const {
+template <int ROWS, int COLS>
+bool BasicBoard<ROWS, COLS>::check(const Block& query) const {
+  return check(query, query.translation, query.rotation);
+}
+
+template <int ROWS, int COLS>
+bool BasicBoard<ROWS, COLS>::check(const Block& query, const Point& translation,
+                                   int rotation) const {
+  if (query.has_shape_table) {
+    const ShapeRotation& shape = query.shape.rotations[rotation & 3];
+    int top = query.center.i + translation.i + shape.min_i;
+    int left = query.center.j + translation.j + shape.min_j;
+    if (top < 0 || top + shape.height > ROWS ||
+        left < 0 || left + shape.width > COLS) {
+      return false;
+    }
+    for (int k = 0; k < shape.height; k++) {
+      if (row_masks[top + k] & ((RowMask)shape.rows[k] << left)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
   Point point;
   for (int i = 0; i < query.size; i++) {
-    point.i = query.center.i + query.translation.i;
-    point.j = query.center.j + query.translation.j;
-    if (query.rotation % 2) {
-      point.i += (2 - query.rotation)*query.offsets[i].j;
-      point.j +=  -(2 - query.rotation)*query.offsets[i].i;
+    point.i = query.center.i + translation.i;
+    point.j = query.center.j + translation.j;
+    if (rotation % 2) {
+      point.i += (2 - rotation)*query.offsets[i].j;
+      point.j +=  -(2 - rotation)*query.offsets[i].i;
     } else {
-      point.i += (1 - query.rotation)*query.offsets[i].i;
-      point.j += (1 - query.rotation)*query.offsets[i].j;
+      point.i += (1 - rotation)*query.offsets[i].i;
+      point.j += (1 - rotation)*query.offsets[i].j;
     }
     if (point.i < 0 || point.i >= ROWS ||
         point.j < 0 || point.j >= COLS || bitmap[point.i][point.j]) {
@@ -186,7 +251,8 @@ bool Board::check(const Block& query) const {
 // drops it onto the board. Returns a pointer to the new board state object.
 //
 // Throws an exception if the block is ever in an invalid position.
-Board* Board::do_commands(const vector<string>& commands) {
+template <int ROWS, int COLS>
+BasicBoard<ROWS, COLS>* BasicBoard<ROWS, COLS>::do_commands(const vector<string>& commands) {
   block->reset_position();
   if (!check(*block)) {
     throw Exception("Block started in an invalid position");
@@ -213,58 +279,75 @@ Board* Board::do_commands(const vector<string>& commands) {
 // Assumes the block starts out in valid position.
 // This method translates the current block downwards.
 //
-// If there are no blocks left in the preview list, this method will fail badly!
-// This is okay because we don't expect to look ahead that far.
-Board* Board::place(int &row_removed) {
-  Board* new_board = new Board();
+// If there are no blocks left in the preview list, the new board has no block.
+template <int ROWS, int COLS>
+BasicBoard<ROWS, COLS>* BasicBoard<ROWS, COLS>::place(int &row_removed) {
+  BasicBoard* new_board = new BasicBoard();
+  row_removed = place_into(*block, block->translation, block->rotation, new_board,
+                           &block->translation);
+  return new_board;
+}
 
-  while (check(*block)) {
-    block->down();
-  }
-  block->up();
+template <int ROWS, int COLS>
+int BasicBoard<ROWS, COLS>::place_into(const Block& query, const Point& translation, int rotation,
+                                       BasicBoard* result, Point* landing) const {
+  Point drop = translation;
+  do {
+    drop.i += 1;
+  } while (check(query, drop, rotation));
+  drop.i -= 1;
+  *landing = drop;
 
   for (int i = 0; i < ROWS; i++) {
     for (int j = 0; j < COLS; j++) {
-      new_board->bitmap[i][j] = bitmap[i][j];
+      result->bitmap[i][j] = bitmap[i][j];
     }
   }
 
   Point point;
-  for (int i = 0; i < block->size; i++) {
-    point.i = block->center.i + block->translation.i;
-    point.j = block->center.j + block->translation.j;
-    if (block->rotation % 2) {
-      point.i += (2 - block->rotation)*block->offsets[i].j;
-      point.j +=  -(2 - block->rotation)*block->offsets[i].i;
-    } else {
-      point.i += (1 - block->rotation)*block->offsets[i].i;
-      point.j += (1 - block->rotation)*block->offsets[i].j;
+  if (query.has_shape_table) {
+    const ShapeRotation& shape = query.shape.rotations[rotation & 3];
+    point.i = query.center.i + drop.i;
+    point.j = query.center.j + drop.j;
+    for (int i = 0; i < query.size; i++) {
+      result->bitmap[point.i + shape.cells[i].i][point.j + shape.cells[i].j] = 1;
+    }
+  } else {
+    for (int i = 0; i < query.size; i++) {
+      point.i = query.center.i + drop.i;
+      point.j = query.center.j + drop.j;
+      if (rotation % 2) {
+        point.i += (2 - rotation)*query.offsets[i].j;
+        point.j +=  -(2 - rotation)*query.offsets[i].i;
+      } else {
+        point.i += (1 - rotation)*query.offsets[i].i;
+        point.j += (1 - rotation)*query.offsets[i].j;
+      }
+      result->bitmap[point.i][point.j] = 1;
     }
-    new_board->bitmap[point.i][point.j] = 1;
   }
-  row_removed = Board::remove_rows(&(new_board->bitmap));
+  int rows_removed = remove_rows(&(result->bitmap));
+  result->update_row_masks();
 
-  new_board->block = preview[0];
-  for (int i = 1; i < preview.size(); i++) {
-    new_board->preview.push_back(preview[i]);
-  }
+  result->block = preview.size() > 0 ? preview[0] : NULL;
+  result->preview = preview.next();
 
-  return new_board;
+  return rows_removed;
 }
 
 // A static method that takes in a new_bitmap and removes any full rows from it.
 // Mutates the new_bitmap in place.
-int Board::remove_rows(Bitmap* new_bitmap) {
+template <int ROWS, int COLS>
+int BasicBoard<ROWS, COLS>::remove_rows(Bitmap* new_bitmap) {
   int rows_removed = 0;
   for (int i = ROWS - 1; i >= 0; i--) {
-    bool full = true;
+    // Gather the row into a mask rather than branching on every cell; COLS is
+    // a compile-time constant, so this loop is fully unrolled.
+    RowMask row = 0;
     for (int j = 0; j < COLS; j++) {
-      if (!(*new_bitmap)[i][j]) {
-        full = false;
-        break;
-      }
+      row |= (RowMask)((*new_bitmap)[i][j] != 0) << j;
     }
-    if (full) {
+    if (row == FULL_ROW) {
       rows_removed += 1;
     } else if (rows_removed) {
       for (int j = 0; j < COLS; j++) {
@@ -280,231 +363,229 @@ int Board::remove_rows(Bitmap* new_bitmap) {
   return rows_removed;
 }
 
-// get the landing height
-int get_landing_height(Block* block) {
-    return block->center.i + block->translation.i;
+template <int ROWS, int COLS>
+void BasicBoard<ROWS, COLS>::update_row_masks() {
+  for (int i = 0; i < ROWS; i++) {
+    RowMask row = 0;
+    for (int j = 0; j < COLS; j++) {
+      row |= (RowMask)(bitmap[i][j] != 0) << j;
+    }
+    row_masks[i] = row;
+  }
 }
 
-static int points_earned(int rows_cleared) {
-  return (1 << rows_cleared) - 1;
-}
+// The evaluator the engine plays with.
+static const ShippedEvaluator evaluator(SHIPPED_WEIGHTS);
 
-// get the number of holes in the board
-int get_number_of_holes(Board *board) {
-    int holes = 0;
-    for (int i = ROWS - 1; i >= 0; i--) {
-        int row_holes = 0;
-        for (int j = 0; j < COLS; j++) {
-            if (board->bitmap[i][j] == 0) {
-                row_holes++;
-            }
-        }
-        if (row_holes == COLS) continue;
-        holes += row_holes;
-    }
-    return holes;
-}
-
-// get row transitions
-int get_row_transitions(Board *board) {
-    int transitions = 0;
-    int cell, last_cell = 1;
-    for (int i = 0; i < ROWS; i++) {
-        for (int j = 0; j < COLS; j++) {
-            cell = board->bitmap[i][j];
-            if (cell != last_cell) {
-                ++transitions;
-            }
-            last_cell = cell;
-        }
-        if (cell == 0) {
-          ++transitions;
-        }
-
-        last_cell = 1;
-    }
-    return transitions;
+bool engine_debug = true;
+
+ostream& debug_log() {
+  // A stream without a buffer drops everything written to it. Each thread
+  // gets its own, since writing to it still sets its error state.
+  static thread_local ostream nowhere(NULL);
+  return engine_debug ? cerr : nowhere;
 }
 
-// get column transitions
-int get_col_transitions(Board *board) {
-    int transitions = 0;
-    int cell, last_cell = 1;
-    for (int j = 0; j < COLS; j++) {
-        for (int i = 0; i < ROWS; i++) {
-            cell = board->bitmap[i][j];
-            if (cell != last_cell) {
-                ++transitions;
-            }
-            last_cell = cell;
-        }
-        if (cell == 0) {
-          ++transitions;
-        }
-        last_cell = 1;
-    }
-    return transitions;
-}
-
-// get well sum
-int get_well_sum(Board *board) {
-    int well_sum = 0;
-    for (int col = 0; col < COLS; col++) {
-        int has_a_roof = false;
-        int found_well = false;
-        for (int row = 0; row < ROWS; row++) {
-            if (board->bitmap[row][col]) {
-                has_a_roof = true;
-            }
-            if (!has_a_roof) {
-                bool leftcol = (col== 0) || board->bitmap[row][col - 1];
-                bool rightcol = (col == COLS - 1) || board->bitmap[row][col + 1];
-                if (!board->bitmap[row][col] && leftcol && rightcol) {
-                    if (!found_well) {
-                        found_well = true;
-                        for (int i = row; i < ROWS; i++) {
-                            if (!board->bitmap[i][col]) {
-                                well_sum++;
-                            }
-                        }
-                    }
-                }
-            }
-        }
-    }
-    return well_sum;
-}
-#define ROWS_REMOVED 0.378565931393
-#define ROW_TRANSITIONS -0.548886169599
-#define LANDING_HEIGHT 0.71240334146
-#define POINTS_EARNED 0.378565931393
-#define HOLES -1.99902287016
-#define WELL_SUMS -0.151923526632
-#define COL_TRANSITIONS -0.793256698244
-
-float calc_score(Board board) {
-  Block* block = board.block;
-  Point prev_translation = block->translation;
-  int prev_rotation = block->rotation;
-  int row_removed = 0;
-  Board* new_board = board.place(row_removed);
+template <int ROWS, int COLS>
+float calc_score(const BasicBoard<ROWS, COLS>& board, const Point& translation, int rotation,
+                 BasicBoard<ROWS, COLS>* scratch) {
+  const Block& block = *board.block;
+  Point landing;
+  int row_removed = board.place_into(block, translation, rotation, scratch, &landing);
   // calculate score
   float score = 0;
   for (int i = 0 ; i < ROWS; ++i) {
     for (int j =0 ; j< COLS; ++j) {
-      cerr << new_board->bitmap[i][j] << ' ';
+      debug_log() << scratch->bitmap[i][j] << ' ';
     }
-    cerr << endl;
-  }
-  int landing_height = get_landing_height(block);
-  int number_of_holes = get_number_of_holes(new_board);
-  int row_transitions = get_row_transitions(new_board);
-  int col_transitions = get_col_transitions(new_board);
-  int well_sum = get_well_sum(new_board);
-  int points = points_earned(row_removed);
-  score = row_removed * ROWS_REMOVED + landing_height * LANDING_HEIGHT
-    + number_of_holes * HOLES + row_transitions * ROW_TRANSITIONS
-    + col_transitions * COL_TRANSITIONS + well_sum * WELL_SUMS
-    + points * POINTS_EARNED;
-  cerr << "l_height: " << landing_height << endl;
-  cerr << "holes: " << number_of_holes << endl;
-  cerr << "r_trans: " << row_transitions << endl;
-  cerr << "c_trans: " << col_transitions << endl;
-  cerr << "well_sum: " << well_sum << endl;
-  cerr << "points: " << points << endl;
-  cerr << "score : " << score << endl;
-  cerr << "block pos : " << block->center.i + block->translation.i << " , " << block->center.j + block->translation.j << endl;
-  cerr << "==============================\n";
-
-  block->translation = prev_translation;
-  block->rotation = prev_rotation;
+    debug_log() << endl;
+  }
+  int values[NUM_FEATURES];
+  score = evaluator.score(*scratch, block.center.i + landing.i, row_removed, values);
+  debug_log() << "l_height: " << values[LANDING_HEIGHT] << endl;
+  debug_log() << "holes: " << values[HOLES] << endl;
+  debug_log() << "r_trans: " << values[ROW_TRANSITIONS] << endl;
+  debug_log() << "c_trans: " << values[COL_TRANSITIONS] << endl;
+  debug_log() << "well_sum: " << values[WELL_SUMS] << endl;
+  debug_log() << "points: " << values[POINTS_EARNED] << endl;
+  debug_log() << "score : " << score << endl;
+  debug_log() << "block pos : " << block.center.i + landing.i << " , " << block.center.j + landing.j << endl;
+  debug_log() << "==============================\n";
   return score;
 }
 
 // only calculates left/right, rotation
-vector<string> get_moves(Block* block) {
-  cerr << "rotation: " << block->rotation << endl;
+vector<string> get_moves(int rotation, int translation) {
+  debug_log() << "rotation: " << rotation << endl;
   vector<string> moves;
-  for (int i = 0; i < block->rotation; ++i) {
+  for (int i = 0; i < rotation; ++i) {
     moves.push_back("rotate");
   }
-  if (block->translation.j > 0) {
-    for (int i = 0; i < block->translation.j; ++i) {
+  if (translation > 0) {
+    for (int i = 0; i < translation; ++i) {
       moves.push_back("right");
     }
   }
-  else if (block->translation.j < 0) {
-    for (int i = 0; i < -block->translation.j; ++i) {
+  else if (translation < 0) {
+    for (int i = 0; i < -translation; ++i) {
       moves.push_back("left");
     }
   }
   return moves;
 }
 
-vector<string> pick_move(Board board) {
-  Block* block = board.block;
-  float max_score = -99999999;
-  vector<string> best_moves;
-  for (int i = 0; i < 4; ++i) {
-    block->translation.i = 0;
-    block->translation.j = 0;
-    while (board.check(*block)) {
-      block->left();
-      if (board.check(*block)) {
-        float score = calc_score(board);
-        if (score > max_score) {
-          max_score = score;
-          best_moves = get_moves(block);
-          //cerr << "size " << best_moves.size() << endl;
-          for (int z = 0; z < best_moves.size(); ++z) {
-            cerr << best_moves[z]<<endl;
-          }
-        }
-      }
+// Adds the board's block dropped from `translation` and `rotation` to the
+// candidates, sharing the board it lands on with an earlier candidate that
+// landed on the same one.
+template <int ROWS, int COLS>
+void add_candidate(const BasicBoard<ROWS, COLS>& board, const Point& translation, int rotation,
+                   MoveScratch<ROWS, COLS>* scratch) {
+  const Block& block = *board.block;
+  Point landing;
+  int row_removed = board.place_into(block, translation, rotation, &scratch->board, &landing);
+  Candidate candidate = {rotation, translation.j, (int)scratch->packed.size(), 0};
+  scratch->packed.resize(scratch->packed.size() + 1);
+  pack_board(scratch->board, block.center.i + landing.i, row_removed, &scratch->packed.back());
+
+  // Rotations of a symmetric block land on the same board.
+  uint64_t key = board_hash(scratch->packed.back());
+  vector<uint64_t>& keys = scratch->keys;
+  size_t k = 0;
+  while (k < keys.size() && keys[k] != key) {
+    k++;
+  }
+  if (k < keys.size()) {
+    candidate.packed = k;
+    scratch->packed.pop_back();
+  } else {
+    keys.push_back(key);
+  }
+  scratch->candidates.push_back(candidate);
+}
+
+template <int ROWS, int COLS>
+void generate_placements(const BasicBoard<ROWS, COLS>& board, vector<Placement>* placements) {
+  // The block starts unrotated and in the middle.
+  const Block& block = *board.block;
+  for (int rotation = 0; rotation < 4; ++rotation) {
+    Point translation = {0, 0};
+    if (!board.check(block, translation, rotation)) {
+      continue;
+    }
+    for (translation.j = -1; board.check(block, translation, rotation); --translation.j) {
+      Placement placement = {rotation, translation.j};
+      placements->push_back(placement);
+    }
+    for (translation.j = 1; board.check(block, translation, rotation); ++translation.j) {
+      Placement placement = {rotation, translation.j};
+      placements->push_back(placement);
     }
+  }
+}
 
-    block->translation.i = 0;
-    block->translation.j = 0;
-
-    while (board.check(*block)) {
-      block->right();
-      if (board.check(*block)) {
-        float score = calc_score(board);
-        if (score > max_score) {
-          max_score = score;
-          best_moves = get_moves(block);
-          for (int z = 0; z < best_moves.size(); ++z) {
-            cerr << best_moves[z]<<endl;
-          }
-        }
-      }
+template <int ROWS, int COLS>
+vector<string> pick_move(const BasicBoard<ROWS, COLS>& board, MoveScratch<ROWS, COLS>* scratch,
+                         const Weights& weights) {
+  PhaseClock clock(scratch->stats);
+  clock.next(PHASE_GENERATE);
+  scratch->candidates.clear();
+  scratch->packed.clear();
+  scratch->keys.clear();
+
+  // Collect every placement first, then score them all in one batch.
+  vector<Placement>& placements = scratch->placements;
+  placements.clear();
+  generate_placements(board, &placements);
+  clock.next(PHASE_PLACE);
+  for (size_t k = 0; k < placements.size(); ++k) {
+    Point translation = {0, placements[k].translation};
+    add_candidate(board, translation, placements[k].rotation, scratch);
+  }
+
+  // Score each distinct board once.
+  clock.next(PHASE_EVALUATE);
+  size_t distinct = scratch->packed.size();
+  vector<float>& scores = scratch->scores;
+  vector<int>& features = scratch->features;
+  scores.resize(distinct);
+  features.resize(distinct * NUM_FEATURES);
+  // The shipped weights' features are known at compile time; other weights
+  // may need any feature.
+  if ((used_features(weights) & ~SHIPPED_FEATURES) == 0) {
+    evaluate_batch<SHIPPED_FEATURES>(scratch->packed.data(), distinct, scores.data(), weights,
+                                     features.data());
+  } else {
+    evaluate_batch<ALL_FEATURES>(scratch->packed.data(), distinct, scores.data(), weights,
+                                 features.data());
+  }
+
+  clock.next(PHASE_SELECT);
+  vector<Candidate>& candidates = scratch->candidates;
+  if (TurnStats* stats = scratch->stats) {
+    stats->placements += placements.size();
+    stats->evaluations += distinct;
+    stats->merged += placements.size() - distinct;
+  }
+  float max_score = -99999999;
+  int best = -1;
+  for (size_t k = 0; k < candidates.size(); ++k) {
+    candidates[k].score = scores[candidates[k].packed];
+    if (candidates[k].score > max_score) {
+      max_score = candidates[k].score;
+      best = k;
     }
-    block->rotate();
   }
-  cerr << "BEST: " << max_score << endl;
+  // Only the winner's moves are built.
+  vector<string> best_moves;
+  if (best >= 0) {
+    best_moves = get_moves(candidates[best].rotation, candidates[best].translation);
+  }
+  debug_log() << "BEST: " << max_score << endl;
   for (int z = 0; z < best_moves.size(); ++z) {
-    cerr << best_moves[z]<<endl;
+    debug_log() << best_moves[z]<<endl;
   }
 
   return best_moves;
 }
 
-int main(int argc, char** argv) {
-  // Construct a JSON Object with the given game state.
-  istringstream raw_state(argv[1]);
-  Object state;
-  Reader::Read(state, raw_state);
+// Builds a board of the given geometry from the game state and picks a move.
+template <int ROWS, int COLS>
+vector<string> play(const GameState& state, TurnStats* stats) {
+  PhaseClock clock(stats);
+  clock.next(PHASE_SETUP);
+  BasicBoard<ROWS, COLS> board(state);
 
-  // Construct a board from this Object.
-  Board board(state);
+  MoveScratch<ROWS, COLS> scratch;
+  scratch.stats = stats;
+  clock.stop();
 
-  cerr << "HERE\n";
+  debug_log() << "HERE\n";
   // Make some moves!
-  vector<string> moves;
-  moves = pick_move(board);
-  // Ignore the last move, because it moved the block into invalid
-  // position. Make all the rest.
-  for (int i = 0; i < moves.size(); i++) {
-    cout << moves[i] << endl;
-  }
+  return pick_move(board, &scratch);
 }
+
+// Dispatches to the BasicBoard instantiation matching the bitmap's
+// dimensions.
+vector<string> play_any(const GameState& state, TurnStats* stats) {
+  int rows = state.rows;
+  int cols = state.cols;
+
+#define PLAY_GEOMETRY(R, C) \
+  if (rows == R && cols == C) return play<R, C>(state, stats);
+  FOR_EACH_GEOMETRY(PLAY_GEOMETRY)
+#undef PLAY_GEOMETRY
+
+  ostringstream message;
+  message << "Unsupported board geometry " << rows << "x" << cols;
+  throw Exception(message.str());
+}
+
+// Everything other programs link against, for each geometry.
+#define INSTANTIATE_GEOMETRY(R, C) \
+  template class BasicBoard<R, C>; \
+  template void generate_placements(const BasicBoard<R, C>&, vector<Placement>*); \
+  template float calc_score(const BasicBoard<R, C>&, const Point&, int, BasicBoard<R, C>*); \
+  template vector<string> pick_move(const BasicBoard<R, C>&, MoveScratch<R, C>*, \
+                                    const Weights&);
+FOR_EACH_GEOMETRY(INSTANTIATE_GEOMETRY)
+#undef INSTANTIATE_GEOMETRY
@@ -1,19 +1,48 @@
+#ifndef DROPBLOX_AI_H_
+#define DROPBLOX_AI_H_
+
 #include "json/reader.h"
 #include "json/elements.h"
+#include "piece_catalog.h"
 
 #include <sstream>
 #include <vector>
+#include <stdint.h>
 
 using namespace json;
 using namespace std;
 
-#define ROWS 33
-#define COLS 12
 #define PREVIEW_SIZE 5
 
-typedef int Bitmap[ROWS][COLS];
+// The geometry used by the competition server. Boards of other sizes are
+// separate instantiations of BasicBoard; see FOR_EACH_GEOMETRY.
+#define DEFAULT_ROWS 33
+#define DEFAULT_COLS 12
+
+// Calls X(ROWS, COLS) for every geometry the engine is built for. To support
+// another board size, add it here.
+#define FOR_EACH_GEOMETRY(X) \
+  X(DEFAULT_ROWS, DEFAULT_COLS) \
+  X(20, 10) \
+  X(24, 10) \
+  X(40, 16)
+
+// Picks the narrowest unsigned integer with one bit per column of a board
+// that is COLS wide.
+template <int COLS, bool FITS_16 = (COLS <= 16), bool FITS_32 = (COLS <= 32)>
+struct RowMaskFor {
+  typedef uint64_t type;
+};
+
+template <int COLS>
+struct RowMaskFor<COLS, true, true> {
+  typedef uint16_t type;
+};
 
-class Board;
+template <int COLS>
+struct RowMaskFor<COLS, false, true> {
+  typedef uint32_t type;
+};
 
 class Point {
  public:
@@ -24,17 +53,24 @@ class Point {
 class Block {
  public:
   // The size of a block is the number of squares in the block.
-  // We pre-allocate 10 Points for offsets, but only use `size` of them.
-  // The block's center, size and offsets should not be mutated.
+  // The block's center, size, offsets and shape should not be mutated.
   Point center;
   int size;
-  Point offsets[10];
+  vector<Point> offsets;
   // To move the block, we can change the Point "translation" or increment
   // the value "rotation".
   Point translation;
   int rotation;
+  // The index of the block's shape in PIECE_CATALOG, or NO_SHAPE.
+  int shape_id;
+  // The cells and row masks of each rotation, kept inline so that checking
+  // a block never leaves it. Only valid if has_shape_table; blocks too big
+  // for a ShapeTable are rotated cell by cell from `offsets` instead.
+  bool has_shape_table;
+  ShapeTable shape;
 
   Block(Object& raw_block);
+  Block(const Point& center, const vector<Point>& offsets);
   void left();
   void right();
   void up();
@@ -46,11 +82,11 @@ class Block {
   // return true if the move succeeded.
   //
   // The block is still assumed to start in a legal position.
-  bool checked_left(const Board& board);
-  bool checked_right(const Board& board);
-  bool checked_up(const Board& board);
-  bool checked_down(const Board& board);
-  bool checked_rotate(const Board& board);
+  template <typename BoardT> bool checked_left(const BoardT& board);
+  template <typename BoardT> bool checked_right(const BoardT& board);
+  template <typename BoardT> bool checked_up(const BoardT& board);
+  template <typename BoardT> bool checked_down(const BoardT& board);
+  template <typename BoardT> bool checked_rotate(const BoardT& board);
 
   // Performs a command or a list of commands to move a block. A command is one of
   // "left", "right", "up", "down", "rotate".
@@ -62,21 +98,86 @@ class Block {
  private:
   // This isn't a standard function, just used to reverse rotation when it fails.
   void unrotate();
+
+  // Sets up the shape table and starting position once the center and
+  // offsets are known.
+  void init();
 };
 
-class Board {
- public:
+// The most rows a GameState can hold.
+#define MAX_STATE_ROWS 64
+
+// The parts of the game state the engine uses, in the form the board wants
+// them. See parse_game_state in state_parser.h.
+struct GameState {
   int rows;
   int cols;
-  Bitmap bitmap;
+  // row_masks[i] has bit j set iff the square at row i, column j is occupied.
+  uint64_t row_masks[MAX_STATE_ROWS];
   Block* block;
   vector<Block*> preview;
 
-  Board(Object& state);
+  GameState() : rows(0), cols(0), block(NULL) {}
+};
+
+// A view onto the upcoming blocks. All boards descended from the same root
+// share one immutable sequence of blocks and only differ in where their view
+// starts, so drawing the next block is an index increment, not a copy.
+class Preview {
+ public:
+  Preview() : blocks(NULL), start(0) {}
+  Preview(const vector<Block*>* blocks, int start) : blocks(blocks), start(start) {}
+
+  int size() const {
+    return blocks ? (int)blocks->size() - start : 0;
+  }
+  Block* operator[](int i) const {
+    return (*blocks)[start + i];
+  }
+
+  // Returns the view seen by the board after the current block is placed.
+  Preview next() const {
+    return Preview(blocks, start + 1);
+  }
+
+ private:
+  const vector<Block*>* blocks;
+  int start;
+};
+
+// A board is templated on its geometry so that every row and column loop has
+// a compile-time trip count, and so that row masks get the narrowest type that
+// fits. Use the Board typedef below for the competition geometry.
+template <int ROWS, int COLS>
+class BasicBoard {
+ public:
+  typedef int Bitmap[ROWS][COLS];
+  typedef typename RowMaskFor<COLS>::type RowMask;
+
+  // A row mask with one bit set for every column.
+  static const RowMask FULL_ROW = (RowMask)(~(uint64_t)0 >> (64 - COLS));
+
+  Bitmap bitmap;
+  // row_masks[i] has bit j set iff bitmap[i][j] is occupied.
+  RowMask row_masks[ROWS];
+  Block* block;
+  Preview preview;
+
+  BasicBoard(Object& state);
+  // Takes over the blocks in `state`, which must have this board's geometry.
+  BasicBoard(const GameState& state);
+  // Fills the board from one mask per row, as in GameState, with `block` to
+  // place and `preview` to follow. The caller keeps ownership of the blocks.
+  BasicBoard(const uint64_t* row_masks, Block* block, const Preview& preview);
+  // An uninitialized board, to be filled in by place_into.
+  BasicBoard();
 
   // Returns true if the `query` block is in valid position - that is, if all of
   // its squares are in bounds and are currently unoccupied.
   bool check(const Block& query) const;
+  // The same, for `query` moved to `translation` and `rotation` instead of
+  // wherever it is.
+  bool check(const Block& query, const Point& translation, int rotation) const;
 
   // Resets the block's position, moves it according to the given commands, then
   // drops it onto the board. Returns a pointer to the new board state object.
@@ -84,7 +185,7 @@ class Board {
   // Throws an exception if the block is ever in an invalid position.
   //
   // A command is one of "left", "right", "up", "down", "rotate".
-  Board* do_commands(const vector<string>& commands);
+  BasicBoard* do_commands(const vector<string>& commands);
 
   // Drops the block from whatever position it is currently at. Returns a
   // pointer to the new board state object, with the next block drawn from the
@@ -93,14 +194,33 @@ class Board {
   // Assumes the block starts out in valid position.
   // This method translates the current block downwards.
   //
-  // If there are no blocks left in the preview list, this method will fail badly!
-  // This is okay because we don't expect to look ahead that far.
-  Board* place(int &);
+  // If there are no blocks left in the preview list, the new board has no block.
+  BasicBoard* place(int &);
+
+  // Drops `query` from `translation` and `rotation` and writes the resulting
+  // board to `result`, with the next block drawn from the preview list. Neither
+  // this board nor `query` is changed, and nothing is allocated. Returns the
+  // number of rows removed, and stores where the block landed in `landing`.
+  //
+  // Assumes the block starts out in valid position.
+  int place_into(const Block& query, const Point& translation, int rotation,
+                 BasicBoard* result, Point* landing) const;
 
   // A static method that takes in a new_bitmap and removes any full rows from it.
   // Mutates the new_bitmap in place.
   static int remove_rows(Bitmap* new_bitmap);
 
- private:
-  Board();
+  // Recomputes row_masks from the bitmap.
+  void update_row_masks();
 };
+
+typedef BasicBoard<DEFAULT_ROWS, DEFAULT_COLS> Board;
+
+struct TurnStats;
+
+// Builds a board with the state's geometry and picks the moves to make.
+// Throws if the engine isn't built for that geometry. If `stats` isn't NULL,
+// what the engine did is recorded in it.
+vector<string> play_any(const GameState& state, TurnStats* stats = NULL);
+
+#endif  // DROPBLOX_AI_H_
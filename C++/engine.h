@@ -0,0 +1,88 @@
+#ifndef ENGINE_H_
+#define ENGINE_H_
+
+#include "batch_evaluator.h"
+#include "turn_stats.h"
+
+#include <iostream>
+
+// The move picker, for programs that drive the engine in-process rather than
+// through main(). Its templates are defined in dropblox_ai.cpp and
+// instantiated there for every geometry in FOR_EACH_GEOMETRY.
+
+// Whether the engine writes its debugging output to cerr. Programs that play
+// many turns in-process turn it off.
+extern bool engine_debug;
+
+// Where the engine's debugging output goes: cerr, or nowhere if engine_debug
+// is off.
+ostream& debug_log();
+
+// Where the block is dropped from: its rotation and horizontal translation.
+struct Placement {
+  int rotation;
+  int translation;
+};
+
+// A placement reached by pick_move's sweeps, with its score.
+struct Candidate {
+  int rotation;
+  int translation;
+  // The index in MoveScratch::packed of the board the candidate lands on.
+  int packed;
+  float score;
+};
+
+// Everything pick_move writes to while it looks for a move. It's allocated
+// once, with room for every placement a block can have, so the candidate
+// loop never allocates.
+template <int ROWS, int COLS>
+struct MoveScratch {
+  // Where to record the turn, or NULL to record nothing.
+  TurnStats* stats;
+  vector<Placement> placements;
+  // The board a candidate lands on.
+  BasicBoard<ROWS, COLS> board;
+  vector<Candidate> candidates;
+  // The distinct boards the candidates land on, their hashes, and what
+  // evaluate_batch made of them. Only the features the weights use are
+  // written.
+  vector<BasicPackedBoard<ROWS, COLS> > packed;
+  vector<uint64_t> keys;
+  vector<float> scores;
+  vector<int> features;
+
+  MoveScratch() : stats(NULL) {
+    // Four rotations, each swept both ways across the board.
+    int most = 4 * 2 * COLS;
+    placements.reserve(most);
+    candidates.reserve(most);
+    packed.reserve(most);
+    keys.reserve(most);
+    scores.reserve(most);
+    features.reserve(most * NUM_FEATURES);
+  }
+};
+
+// Appends every placement of the board's block that pick_move considers, in
+// the order it considers them: for each rotation the block can make where it
+// starts, the block is swept left, then right, until it hits something.
+template <int ROWS, int COLS>
+void generate_placements(const BasicBoard<ROWS, COLS>& board, vector<Placement>* placements);
+
+// Scores the board's block dropped from `translation` and `rotation` with the
+// shipped weights, one feature at a time, writing the board and features to
+// debug_log(). The board it lands on is written to `scratch`. pick_move gets
+// the same scores from evaluate_batch.
+template <int ROWS, int COLS>
+float calc_score(const BasicBoard<ROWS, COLS>& board, const Point& translation, int rotation,
+                 BasicBoard<ROWS, COLS>* scratch);
+
+// Returns the moves that take the board's block to the best placement the
+// engine can find: some number of "rotate"s, then "left"s or "right"s.
+// Placements are scored with `weights`.
+template <int ROWS, int COLS>
+vector<string> pick_move(const BasicBoard<ROWS, COLS>& board, MoveScratch<ROWS, COLS>* scratch,
+                         const Weights& weights = SHIPPED_WEIGHTS);
+
+#endif  // ENGINE_H_
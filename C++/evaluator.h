@@ -0,0 +1,251 @@
+#ifndef EVALUATOR_H_
+#define EVALUATOR_H_
+
+#include "dropblox_ai.h"
+
+// Scoring a placed block is a weighted sum of board features. Which features
+// take part is fixed at compile time by the Evaluator's FEATURES mask, so a
+// feature with no weight is never computed. The shipped engine uses an
+// Evaluator specialized on SHIPPED_WEIGHTS; tuning runs use RuntimeEvaluator,
+// which can compute every feature and takes its weights at runtime.
+
+// The features, in the order their weighted values are summed.
+enum Feature {
+  ROWS_REMOVED = 0,
+  LANDING_HEIGHT,
+  HOLES,
+  ROW_TRANSITIONS,
+  COL_TRANSITIONS,
+  WELL_SUMS,
+  POINTS_EARNED,
+  NUM_FEATURES
+};
+
+// What each feature is called in weight files.
+static const char* const FEATURE_NAMES[NUM_FEATURES] = {
+  "ROWS_REMOVED",
+  "LANDING_HEIGHT",
+  "HOLES",
+  "ROW_TRANSITIONS",
+  "COL_TRANSITIONS",
+  "WELL_SUMS",
+  "POINTS_EARNED",
+};
+
+#define FEATURE_BIT(feature) (1u << (feature))
+#define ALL_FEATURES ((1u << NUM_FEATURES) - 1)
+
+struct Weights {
+  double weights[NUM_FEATURES];
+};
+
+// The weights the engine plays with.
+constexpr Weights SHIPPED_WEIGHTS = {{
+  0.378565931393,   // ROWS_REMOVED
+  0.71240334146,    // LANDING_HEIGHT
+  -1.99902287016,   // HOLES
+  -0.548886169599,  // ROW_TRANSITIONS
+  -0.793256698244,  // COL_TRANSITIONS
+  -0.151923526632,  // WELL_SUMS
+  0.378565931393,   // POINTS_EARNED
+}};
+
+// The features with a nonzero weight.
+constexpr unsigned used_features(const Weights& weights) {
+  unsigned features = 0;
+  for (int f = 0; f < NUM_FEATURES; f++) {
+    if (weights.weights[f] != 0) {
+      features |= FEATURE_BIT(f);
+    }
+  }
+  return features;
+}
+
+// Reads weights written by write_weights: one "NAME value" line per
+// feature. Features that aren't mentioned keep their weight in `weights`.
+inline void read_weights(istream& in, Weights* weights) {
+  string name;
+  double value;
+  while (in >> name >> value) {
+    int f = 0;
+    while (f < NUM_FEATURES && name != FEATURE_NAMES[f]) {
+      f++;
+    }
+    if (f == NUM_FEATURES) {
+      throw Exception("Unknown feature " + name + " in weights");
+    }
+    weights->weights[f] = value;
+  }
+  if (!in.eof()) {
+    throw Exception("Malformed weights");
+  }
+}
+
+inline void write_weights(ostream& out, const Weights& weights) {
+  std::streamsize precision = out.precision(17);
+  for (int f = 0; f < NUM_FEATURES; f++) {
+    out << FEATURE_NAMES[f] << " " << weights.weights[f] << endl;
+  }
+  out.precision(precision);
+}
+
+inline int get_landing_height(const Block* block) {
+  return block->center.i + block->translation.i;
+}
+
+inline int points_earned(int rows_cleared) {
+  return (1 << rows_cleared) - 1;
+}
+
+// get the number of holes in the board
+template <int ROWS, int COLS>
+int get_number_of_holes(const BasicBoard<ROWS, COLS> *board) {
+    int holes = 0;
+    for (int i = ROWS - 1; i >= 0; i--) {
+        int row_holes = 0;
+        for (int j = 0; j < COLS; j++) {
+            if (board->bitmap[i][j] == 0) {
+                row_holes++;
+            }
+        }
+        if (row_holes == COLS) continue;
+        holes += row_holes;
+    }
+    return holes;
+}
+
+// get row transitions
+template <int ROWS, int COLS>
+int get_row_transitions(const BasicBoard<ROWS, COLS> *board) {
+    int transitions = 0;
+    int cell, last_cell = 1;
+    for (int i = 0; i < ROWS; i++) {
+        for (int j = 0; j < COLS; j++) {
+            cell = board->bitmap[i][j];
+            if (cell != last_cell) {
+                ++transitions;
+            }
+            last_cell = cell;
+        }
+        if (cell == 0) {
+          ++transitions;
+        }
+
+        last_cell = 1;
+    }
+    return transitions;
+}
+
+// get column transitions
+template <int ROWS, int COLS>
+int get_col_transitions(const BasicBoard<ROWS, COLS> *board) {
+    int transitions = 0;
+    int cell, last_cell = 1;
+    for (int j = 0; j < COLS; j++) {
+        for (int i = 0; i < ROWS; i++) {
+            cell = board->bitmap[i][j];
+            if (cell != last_cell) {
+                ++transitions;
+            }
+            last_cell = cell;
+        }
+        if (cell == 0) {
+          ++transitions;
+        }
+        last_cell = 1;
+    }
+    return transitions;
+}
+
+// get well sum
+template <int ROWS, int COLS>
+int get_well_sum(const BasicBoard<ROWS, COLS> *board) {
+    int well_sum = 0;
+    for (int col = 0; col < COLS; col++) {
+        int has_a_roof = false;
+        int found_well = false;
+        for (int row = 0; row < ROWS; row++) {
+            if (board->bitmap[row][col]) {
+                has_a_roof = true;
+            }
+            if (!has_a_roof) {
+                bool leftcol = (col== 0) || board->bitmap[row][col - 1];
+                bool rightcol = (col == COLS - 1) || board->bitmap[row][col + 1];
+                if (!board->bitmap[row][col] && leftcol && rightcol) {
+                    if (!found_well) {
+                        found_well = true;
+                        for (int i = row; i < ROWS; i++) {
+                            if (!board->bitmap[i][col]) {
+                                well_sum++;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return well_sum;
+}
+
+// Computes the features in FEATURES for a board that a block was just
+// dropped onto, landing at row `landing_height` and clearing `rows_removed`
+// rows. Features outside FEATURES are left untouched in `values`.
+template <unsigned FEATURES, int ROWS, int COLS>
+void compute_features(const BasicBoard<ROWS, COLS>& board, int landing_height,
+                      int rows_removed, int values[NUM_FEATURES]) {
+  if (FEATURES & FEATURE_BIT(ROWS_REMOVED)) values[ROWS_REMOVED] = rows_removed;
+  if (FEATURES & FEATURE_BIT(LANDING_HEIGHT)) values[LANDING_HEIGHT] = landing_height;
+  if (FEATURES & FEATURE_BIT(HOLES)) values[HOLES] = get_number_of_holes(&board);
+  if (FEATURES & FEATURE_BIT(ROW_TRANSITIONS)) values[ROW_TRANSITIONS] = get_row_transitions(&board);
+  if (FEATURES & FEATURE_BIT(COL_TRANSITIONS)) values[COL_TRANSITIONS] = get_col_transitions(&board);
+  if (FEATURES & FEATURE_BIT(WELL_SUMS)) values[WELL_SUMS] = get_well_sum(&board);
+  if (FEATURES & FEATURE_BIT(POINTS_EARNED)) values[POINTS_EARNED] = points_earned(rows_removed);
+}
+
+// Scores boards as the weighted sum of the features in FEATURES. Features
+// outside the mask are never computed and don't contribute to the score, so
+// FEATURES should cover every feature whose weight can be nonzero.
+template <unsigned FEATURES>
+class Evaluator {
+ public:
+  explicit Evaluator(const Weights& weights) : weights(weights) {}
+
+  const Weights& get_weights() const { return weights; }
+
+  // Fills in the features in FEATURES and returns the score they add up to.
+  template <int ROWS, int COLS>
+  float score(const BasicBoard<ROWS, COLS>& board, int landing_height, int rows_removed,
+              int values[NUM_FEATURES]) const {
+    compute_features<FEATURES>(board, landing_height, rows_removed, values);
+    double score = 0;
+    for (int f = 0; f < NUM_FEATURES; f++) {
+      if (FEATURES & FEATURE_BIT(f)) {
+        score += values[f] * weights.weights[f];
+      }
+    }
+    return score;
+  }
+
+  template <int ROWS, int COLS>
+  float score(const BasicBoard<ROWS, COLS>& board, int landing_height, int rows_removed) const {
+    int values[NUM_FEATURES];
+    return score(board, landing_height, rows_removed, values);
+  }
+
+ private:
+  Weights weights;
+};
+
+// The features the shipped weights use. Every shipped weight is nonzero at
+// the moment, so this is ALL_FEATURES, and ShippedEvaluator and the batch
+// pick_move runs with it compute the same features as RuntimeEvaluator
+// until a weight set that drops one is shipped.
+constexpr unsigned SHIPPED_FEATURES = used_features(SHIPPED_WEIGHTS);
+
+// Computes only the features the shipped weights use.
+typedef Evaluator<SHIPPED_FEATURES> ShippedEvaluator;
+
+// Computes every feature, so any weights can be plugged in at runtime.
+typedef Evaluator<ALL_FEATURES> RuntimeEvaluator;
+
+#endif  // EVALUATOR_H_
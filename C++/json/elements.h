@@ -33,6 +33,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <list>
 #include <string>
 #include <stdexcept>
+#include <vector>
 
 /*  
 
@@ -111,10 +112,16 @@ public:
    UnknownElement(const Boolean& boolean);
    UnknownElement(const String& string);
    UnknownElement(const Null& null);
+#if __cplusplus >= 201103L
+   UnknownElement(UnknownElement&& unknown);
+#endif
 
    ~UnknownElement();
 
    UnknownElement& operator = (const UnknownElement& unknown);
+#if __cplusplus >= 201103L
+   UnknownElement& operator = (UnknownElement&& unknown);
+#endif
 
    // implicit cast to actual element type. throws on failure
    operator const Object& () const;
@@ -211,6 +218,9 @@ private:
 /////////////////////////////////////////////////////////////////////////////////
 // Object - mimics std::map<std::string, UnknownElement>. The member value 
 //  contents are effectively heterogeneous thanks to the UnknownElement class
+// Members are kept in insertion order. Once an object grows past a handful of
+//  members, the first lookup builds a small open-addressing hash index over
+//  them, so lookups by name no longer scan the whole list.
 
 class Object
 {
@@ -228,6 +238,14 @@ public:
    typedef Members::iterator iterator;
    typedef Members::const_iterator const_iterator;
 
+   Object();
+   Object(const Object& object);
+   Object& operator = (const Object& object);
+#if __cplusplus >= 201103L
+   Object(Object&& object);
+   Object& operator = (Object&& object);
+#endif
+
    bool operator == (const Object& object) const;
 
    iterator Begin();
@@ -243,6 +261,10 @@ public:
 
    iterator Insert(const Member& member);
    iterator Insert(const Member& member, iterator itWhere);
+#if __cplusplus >= 201103L
+   iterator Insert(Member&& member);
+   iterator Insert(Member&& member, iterator itWhere);
+#endif
    iterator Erase(iterator itWhere);
    void Clear();
 
@@ -252,7 +274,28 @@ public:
 private:
    class Finder;
 
+   // objects with fewer members than this are searched linearly
+   enum { INDEX_THRESHOLD = 8 };
+
+   struct IndexSlot {
+      IndexSlot() : bUsed(false), nHash(0) {}
+      bool bUsed;
+      size_t nHash;
+      iterator itMember;
+   };
+   typedef std::vector<IndexSlot> Index;
+
+   static size_t Hash(const std::string& name);
+   iterator FindIndexed(const std::string& name) const;
+   void BuildIndex() const;
+   void AddToIndex(iterator itMember, size_t nHash) const;
+   void ResetIndex();
+
    Members m_Members;
+
+   // built lazily by Find; empty means "not built". slots hold iterators into
+   //  m_Members, so it must be reset whenever m_Members is copied or moved
+   mutable Index m_Index;
 };
 
 
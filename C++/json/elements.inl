@@ -32,6 +32,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <cassert>
 #include <algorithm>
 #include <map>
+#include <utility>
 
 /*  
 
@@ -138,6 +139,11 @@ inline UnknownElement::UnknownElement(const Boolean& boolean) :         m_pImp(
 inline UnknownElement::UnknownElement(const String& string) :           m_pImp( new Imp_T<String>(string) ) {}
 inline UnknownElement::UnknownElement(const Null& null) :               m_pImp( new Imp_T<Null>(null) ) {}
 
+#if __cplusplus >= 201103L
+// the moved-from element is left holding a Null, like a default-constructed one
+inline UnknownElement::UnknownElement(UnknownElement&& unknown) :       m_pImp( unknown.m_pImp ) { unknown.m_pImp = new Imp_T<Null>( Null() ); }
+#endif
+
 inline UnknownElement::~UnknownElement()   { delete m_pImp; }
 
 inline UnknownElement::operator const Object& () const    { return CastTo<Object>(); }
@@ -170,6 +176,15 @@ inline UnknownElement& UnknownElement::operator = (const UnknownElement& unknown
    return *this;
 }
 
+#if __cplusplus >= 201103L
+inline UnknownElement& UnknownElement::operator = (UnknownElement&& unknown)
+{
+   // swapping hands our old imp to the moved-from element, which will clean it up
+   std::swap(m_pImp, unknown.m_pImp);
+   return *this;
+}
+#endif
+
 inline UnknownElement& UnknownElement::operator[] (const std::string& key)
 {
    // the people want an object. make us one if we aren't already
@@ -265,6 +280,41 @@ private:
 
 
 
+inline Object::Object() {}
+
+// the index refers to the source's members, so it is never copied or moved
+inline Object::Object(const Object& object) :
+   m_Members(object.m_Members) {}
+
+inline Object& Object::operator = (const Object& object)
+{
+   if (&object != this)
+   {
+      m_Members = object.m_Members;
+      ResetIndex();
+   }
+   return *this;
+}
+
+#if __cplusplus >= 201103L
+inline Object::Object(Object&& object) :
+   m_Members(std::move(object.m_Members))
+{
+   object.ResetIndex();
+}
+
+inline Object& Object::operator = (Object&& object)
+{
+   if (&object != this)
+   {
+      m_Members = std::move(object.m_Members);
+      ResetIndex();
+      object.ResetIndex();
+   }
+   return *this;
+}
+#endif
+
 inline Object::iterator Object::Begin() { return m_Members.begin(); }
 inline Object::iterator Object::End() { return m_Members.end(); }
 inline Object::const_iterator Object::Begin() const { return m_Members.begin(); }
@@ -273,14 +323,73 @@ inline Object::const_iterator Object::End() const { return m_Members.end(); }
 inline size_t Object::Size() const { return m_Members.size(); }
 inline bool Object::Empty() const { return m_Members.empty(); }
 
+// FNV-1a
+inline size_t Object::Hash(const std::string& name)
+{
+   size_t nHash = 2166136261u;
+   for (std::string::const_iterator it = name.begin(); it != name.end(); ++it)
+      nHash = (nHash ^ (unsigned char)*it) * 16777619u;
+   return nHash;
+}
+
+inline void Object::AddToIndex(iterator itMember, size_t nHash) const
+{
+   size_t nMask = m_Index.size() - 1;
+   size_t nSlot = nHash & nMask;
+   while (m_Index[nSlot].bUsed)
+      nSlot = (nSlot + 1) & nMask;
+   m_Index[nSlot].bUsed = true;
+   m_Index[nSlot].nHash = nHash;
+   m_Index[nSlot].itMember = itMember;
+}
+
+inline void Object::BuildIndex() const
+{
+   // keep the load factor at or below one half
+   size_t nSlots = 16;
+   while (nSlots < 2 * m_Members.size())
+      nSlots *= 2;
+
+   m_Index.assign(nSlots, IndexSlot());
+   Members& members = const_cast<Members&>(m_Members);
+   for (iterator it = members.begin(); it != members.end(); ++it)
+      AddToIndex(it, Hash(it->name));
+}
+
+inline void Object::ResetIndex()
+{
+   Index().swap(m_Index);
+}
+
+inline Object::iterator Object::FindIndexed(const std::string& name) const
+{
+   Members& members = const_cast<Members&>(m_Members);
+   if (m_Index.empty())
+   {
+      if (m_Members.size() < INDEX_THRESHOLD)
+         return std::find_if(members.begin(), members.end(), Finder(name));
+      BuildIndex();
+   }
+
+   size_t nHash = Hash(name);
+   size_t nMask = m_Index.size() - 1;
+   for (size_t nSlot = nHash & nMask; m_Index[nSlot].bUsed; nSlot = (nSlot + 1) & nMask)
+   {
+      const IndexSlot& slot = m_Index[nSlot];
+      if (slot.nHash == nHash && slot.itMember->name == name)
+         return slot.itMember;
+   }
+   return members.end();
+}
+
 inline Object::iterator Object::Find(const std::string& name) 
 {
-   return std::find_if(m_Members.begin(), m_Members.end(), Finder(name));
+   return FindIndexed(name);
 }
 
 inline Object::const_iterator Object::Find(const std::string& name) const 
 {
-   return std::find_if(m_Members.begin(), m_Members.end(), Finder(name));
+   return FindIndexed(name);
 }
 
 inline Object::iterator Object::Insert(const Member& member)
@@ -290,16 +399,49 @@ inline Object::iterator Object::Insert(const Member& member)
 
 inline Object::iterator Object::Insert(const Member& member, iterator itWhere)
 {
+#if __cplusplus >= 201103L
+   return Insert(Member(member), itWhere);
+#else
    iterator it = Find(member.name);
    if (it != m_Members.end())
       throw Exception(std::string("Object member already exists: ") + member.name);
 
    it = m_Members.insert(itWhere, member);
+   if (m_Index.empty() == false)
+      ResetIndex();
+   return it;
+#endif
+}
+
+#if __cplusplus >= 201103L
+inline Object::iterator Object::Insert(Member&& member)
+{
+   return Insert(std::move(member), End());
+}
+
+inline Object::iterator Object::Insert(Member&& member, iterator itWhere)
+{
+   iterator it = Find(member.name);
+   if (it != m_Members.end())
+      throw Exception(std::string("Object member already exists: ") + member.name);
+
+   it = m_Members.insert(itWhere, std::move(member));
+   if (m_Index.empty() == false)
+   {
+      // grow (by rebuilding) before the load factor passes one half
+      if (2 * m_Members.size() > m_Index.size())
+         BuildIndex();
+      else
+         AddToIndex(it, Hash(it->name));
+   }
    return it;
 }
+#endif
 
 inline Object::iterator Object::Erase(iterator itWhere) 
 {
+   // open addressing makes removal fiddly; just rebuild on the next lookup
+   ResetIndex();
    return m_Members.erase(itWhere);
 }
 
@@ -309,8 +451,7 @@ inline UnknownElement& Object::operator [](const std::string& name)
    iterator it = Find(name);
    if (it == m_Members.end())
    {
-      Member member(name);
-      it = Insert(member, End());
+      it = Insert(Member(name), End());
    }
    return it->element;      
 }
@@ -326,6 +467,7 @@ inline const UnknownElement& Object::operator [](const std::string& name) const
 inline void Object::Clear() 
 {
    m_Members.clear(); 
+   ResetIndex();
 }
 
 inline bool Object::operator == (const Object& object) const 
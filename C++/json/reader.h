@@ -89,6 +89,45 @@ public:
    // ...otherwise, if you don't know, call this & visit it
    static void Read(UnknownElement& elementRoot, std::istream& istr);
 
+   // SAX-style interface. Rather than building a document, the reader calls
+   //  back into a Handler as it goes, scanning one token at a time, so memory
+   //  use depends only on nesting depth, not on document size. Override the
+   //  callbacks you care about; the rest do nothing. A callback can call Stop
+   //  once the handler has what it needs, and the reader returns as soon as
+   //  the callback does, leaving the stream just past that callback's token.
+   class Handler
+   {
+   public:
+      Handler() : m_bStopped(false) {}
+      virtual ~Handler() {}
+
+      void Stop() { m_bStopped = true; }
+      bool Stopped() const { return m_bStopped; }
+
+      virtual void BeginObject() {}
+      virtual void MemberName(const std::string& name) {}
+      virtual void EndObject() {}
+      virtual void BeginArray() {}
+      virtual void EndArray() {}
+      virtual void StringValue(const std::string& value) {}
+      virtual void NumberValue(double value) {}
+      virtual void BooleanValue(bool value) {}
+      virtual void NullValue() {}
+
+   private:
+      friend class Reader;
+      bool m_bStopped;
+   };
+
+   // reads a single value from the stream, reporting it to the handler. unlike
+   //  the other Read functions, anything following the value is left unread,
+   //  so a stream of concatenated documents (e.g. a log with one per line) can
+   //  be read by calling this in a loop. returns false if the stream held
+   //  nothing but white space. duplicate object member names are not detected.
+   //  malformed input throws a ScanException or ParseException, as with the
+   //  other Read functions
+   static bool Read(Handler& handler, std::istream& istr);
+
 private:
    struct Token
    {
@@ -116,6 +155,7 @@ private:
 
    class InputStream;
    class TokenStream;
+   class LazyTokenStream;
    typedef std::vector<Token> Tokens;
 
    template <typename ElementTypeT>   
@@ -123,6 +163,7 @@ private:
 
    // scanning istream into token sequence
    void Scan(Tokens& tokens, InputStream& inputStream);
+   void ScanToken(Token& token, InputStream& inputStream);
 
    void EatWhiteSpace(InputStream& inputStream);
    std::string MatchString(InputStream& inputStream);
@@ -138,7 +179,12 @@ private:
    void Parse(Boolean& boolean, TokenStream& tokenStream);
    void Parse(Null& null, TokenStream& tokenStream);
 
+   // parsing tokens as they're scanned into handler callbacks
+   void Parse(Handler& handler, LazyTokenStream& tokenStream);
+
    const std::string& MatchExpectedToken(Token::Type nExpected, TokenStream& tokenStream);
+   const std::string& MatchExpectedToken(Token::Type nExpected, LazyTokenStream& tokenStream);
+   static double ConvertNumber(const Token& token);
 };
 
 
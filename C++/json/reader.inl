@@ -30,6 +30,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <cassert>
 #include <set>
 #include <sstream>
+#include <utility>
 
 /*  
 
@@ -146,6 +147,68 @@ inline bool Reader::TokenStream::EOS() const {
    return m_itCurrent == m_Tokens.end(); 
 }
 
+
+//////////////////////////
+// Reader::LazyTokenStream
+
+// like TokenStream, but scans each token from the input only when it's
+//  needed, holding on to at most two of them. a reference returned by Get is
+//  only good until the next call to Get
+class Reader::LazyTokenStream
+{
+public:
+   LazyTokenStream(Reader& reader, InputStream& inputStream);
+
+   const Token& Peek();
+   const Token& Get();
+
+   bool EOS();
+
+private:
+   Reader& m_Reader;
+   InputStream& m_InputStream;
+   Token m_Next;
+   bool m_bHasNext;
+   Token m_Current;
+};
+
+
+inline Reader::LazyTokenStream::LazyTokenStream(Reader& reader, InputStream& inputStream) :
+   m_Reader(reader),
+   m_InputStream(inputStream),
+   m_bHasNext(false)
+{
+   m_Next.nType = m_Current.nType = Token::TOKEN_NULL;
+}
+
+inline const Reader::Token& Reader::LazyTokenStream::Peek() {
+   if (EOS())
+   {
+      std::string sMessage = "Unexpected end of token stream";
+      throw ParseException(sMessage, m_Current.locBegin, m_Current.locEnd); // nowhere to point to
+   }
+   return m_Next;
+}
+
+inline const Reader::Token& Reader::LazyTokenStream::Get() {
+   Peek();
+   std::swap(m_Current, m_Next);
+   m_bHasNext = false;
+   return m_Current;
+}
+
+inline bool Reader::LazyTokenStream::EOS() {
+   if (m_bHasNext == false)
+   {
+      m_Reader.EatWhiteSpace(m_InputStream);
+      if (m_InputStream.EOS())
+         return true;
+      m_Reader.ScanToken(m_Next, m_InputStream);
+      m_bHasNext = true;
+   }
+   return false;
+}
+
 ///////////////////
 // Reader (finally)
 
@@ -159,6 +222,21 @@ inline void Reader::Read(Null& null, std::istream& istr)                    { Re
 inline void Reader::Read(UnknownElement& unknown, std::istream& istr)       { Read_i(unknown, istr); }
 
 
+inline bool Reader::Read(Handler& handler, std::istream& istr)
+{
+   Reader reader;
+
+   InputStream inputStream(istr);
+   LazyTokenStream tokenStream(reader, inputStream);
+   if (tokenStream.EOS())
+      return false;
+
+   handler.m_bStopped = false;
+   reader.Parse(handler, tokenStream);
+   return true;
+}
+
+
 template <typename ElementTypeT>   
 void Reader::Read_i(ElementTypeT& element, std::istream& istr)
 {
@@ -187,87 +265,93 @@ inline void Reader::Scan(Tokens& tokens, InputStream& inputStream)
    {
       // if all goes well, we'll create a token each pass
       Token token;
-      token.locBegin = inputStream.GetLocation();
+      ScanToken(token, inputStream);
+      tokens.push_back(token);
+   }
+}
+
+
+inline void Reader::ScanToken(Token& token, InputStream& inputStream)
+{
+   token.locBegin = inputStream.GetLocation();
+
+   // gives us null-terminated string
+   char sChar = inputStream.Peek();
+   switch (sChar)
+   {
+      case '{':
+         token.sValue = MatchExpectedString(inputStream, "{");
+         token.nType = Token::TOKEN_OBJECT_BEGIN;
+         break;
+
+      case '}':
+         token.sValue = MatchExpectedString(inputStream, "}");
+         token.nType = Token::TOKEN_OBJECT_END;
+         break;
+
+      case '[':
+         token.sValue = MatchExpectedString(inputStream, "[");
+         token.nType = Token::TOKEN_ARRAY_BEGIN;
+         break;
+
+      case ']':
+         token.sValue = MatchExpectedString(inputStream, "]");
+         token.nType = Token::TOKEN_ARRAY_END;
+         break;
+
+      case ',':
+         token.sValue = MatchExpectedString(inputStream, ",");
+         token.nType = Token::TOKEN_NEXT_ELEMENT;
+         break;
+
+      case ':':
+         token.sValue = MatchExpectedString(inputStream, ":");
+         token.nType = Token::TOKEN_MEMBER_ASSIGN;
+         break;
+
+      case '"':
+         token.sValue = MatchString(inputStream);
+         token.nType = Token::TOKEN_STRING;
+         break;
+
+      case '-':
+      case '0':
+      case '1':
+      case '2':
+      case '3':
+      case '4':
+      case '5':
+      case '6':
+      case '7':
+      case '8':
+      case '9':
+         token.sValue = MatchNumber(inputStream);
+         token.nType = Token::TOKEN_NUMBER;
+         break;
+
+      case 't':
+         token.sValue = MatchExpectedString(inputStream, "true");
+         token.nType = Token::TOKEN_BOOLEAN;
+         break;
+
+      case 'f':
+         token.sValue = MatchExpectedString(inputStream, "false");
+         token.nType = Token::TOKEN_BOOLEAN;
+         break;
+
+      case 'n':
+         token.sValue = MatchExpectedString(inputStream, "null");
+         token.nType = Token::TOKEN_NULL;
+         break;
 
-      // gives us null-terminated string
-      char sChar = inputStream.Peek();
-      switch (sChar)
+      default:
       {
-         case '{':
-            token.sValue = MatchExpectedString(inputStream, "{");
-            token.nType = Token::TOKEN_OBJECT_BEGIN;
-            break;
-
-         case '}':
-            token.sValue = MatchExpectedString(inputStream, "}");
-            token.nType = Token::TOKEN_OBJECT_END;
-            break;
-
-         case '[':
-            token.sValue = MatchExpectedString(inputStream, "[");
-            token.nType = Token::TOKEN_ARRAY_BEGIN;
-            break;
-
-         case ']':
-            token.sValue = MatchExpectedString(inputStream, "]");
-            token.nType = Token::TOKEN_ARRAY_END;
-            break;
-
-         case ',':
-            token.sValue = MatchExpectedString(inputStream, ",");
-            token.nType = Token::TOKEN_NEXT_ELEMENT;
-            break;
-
-         case ':':
-            token.sValue = MatchExpectedString(inputStream, ":");
-            token.nType = Token::TOKEN_MEMBER_ASSIGN;
-            break;
-
-         case '"':
-            token.sValue = MatchString(inputStream);
-            token.nType = Token::TOKEN_STRING;
-            break;
-
-         case '-':
-         case '0':
-         case '1':
-         case '2':
-         case '3':
-         case '4':
-         case '5':
-         case '6':
-         case '7':
-         case '8':
-         case '9':
-            token.sValue = MatchNumber(inputStream);
-            token.nType = Token::TOKEN_NUMBER;
-            break;
-
-         case 't':
-            token.sValue = MatchExpectedString(inputStream, "true");
-            token.nType = Token::TOKEN_BOOLEAN;
-            break;
-
-         case 'f':
-            token.sValue = MatchExpectedString(inputStream, "false");
-            token.nType = Token::TOKEN_BOOLEAN;
-            break;
-
-         case 'n':
-            token.sValue = MatchExpectedString(inputStream, "null");
-            token.nType = Token::TOKEN_NULL;
-            break;
-
-         default:
-         {
-            std::string sErrorMessage = std::string("Unexpected character in stream: ") + sChar;
-            throw ScanException(sErrorMessage, inputStream.GetLocation());
-         }
+         std::string sErrorMessage = std::string("Unexpected character in stream: ") + sChar;
+         throw ScanException(sErrorMessage, inputStream.GetLocation());
       }
-
-      token.locEnd = inputStream.GetLocation();
-      tokens.push_back(token);
    }
+
+   token.locEnd = inputStream.GetLocation();
 }
 
 
@@ -436,7 +520,12 @@ inline void Reader::Parse(Object& object, Reader::TokenStream& tokenStream)
       // try adding it to the object (this could throw)
       try
       {
+#if __cplusplus >= 201103L
+         // the member's subtree can be large; don't copy it
+         object.Insert(std::move(member));
+#else
          object.Insert(member);
+#endif
       }
       catch (Exception&)
       {
@@ -487,21 +576,33 @@ inline void Reader::Parse(String& string, Reader::TokenStream& tokenStream)
 inline void Reader::Parse(Number& number, Reader::TokenStream& tokenStream)
 {
    const Token& currentToken = tokenStream.Peek(); // might need this later for throwing exception
-   const std::string& sValue = MatchExpectedToken(Token::TOKEN_NUMBER, tokenStream);
+   MatchExpectedToken(Token::TOKEN_NUMBER, tokenStream);
+   number = ConvertNumber(currentToken);
+}
 
-   std::istringstream iStr(sValue);
+
+inline double Reader::ConvertNumber(const Token& token)
+{
+   std::istringstream iStr(token.sValue);
    double dValue;
    iStr >> dValue;
 
+   // a token like "-" or "e" is made of numeric characters but isn't a number
+   if (iStr.fail())
+   {
+      std::string sMessage = "Malformed NUMBER token: " + token.sValue;
+      throw ParseException(sMessage, token.locBegin, token.locEnd);
+   }
+
    // did we consume all characters in the token?
    if (iStr.eof() == false)
    {
       char c = iStr.peek();
       std::string sMessage = std::string("Unexpected character in NUMBER token: ") + c;
-      throw ParseException(sMessage, currentToken.locBegin, currentToken.locEnd);
+      throw ParseException(sMessage, token.locBegin, token.locEnd);
    }
 
-   number = dValue;
+   return dValue;
 }
 
 
@@ -518,6 +619,94 @@ inline void Reader::Parse(Null&, Reader::TokenStream& tokenStream)
 }
 
 
+inline void Reader::Parse(Handler& handler, Reader::LazyTokenStream& tokenStream)
+{
+   const Token& token = tokenStream.Get();
+   switch (token.nType) {
+      case Token::TOKEN_OBJECT_BEGIN:
+      {
+         handler.BeginObject();
+         if (handler.Stopped())
+            return;
+         bool bContinue = (tokenStream.Peek().nType != Token::TOKEN_OBJECT_END);
+         while (bContinue)
+         {
+            handler.MemberName(MatchExpectedToken(Token::TOKEN_STRING, tokenStream));
+            if (handler.Stopped())
+               return;
+            MatchExpectedToken(Token::TOKEN_MEMBER_ASSIGN, tokenStream);
+            Parse(handler, tokenStream);
+            if (handler.Stopped())
+               return;
+
+            bContinue = (tokenStream.Peek().nType == Token::TOKEN_NEXT_ELEMENT);
+            if (bContinue)
+               MatchExpectedToken(Token::TOKEN_NEXT_ELEMENT, tokenStream);
+         }
+         MatchExpectedToken(Token::TOKEN_OBJECT_END, tokenStream);
+         handler.EndObject();
+         break;
+      }
+
+      case Token::TOKEN_ARRAY_BEGIN:
+      {
+         handler.BeginArray();
+         if (handler.Stopped())
+            return;
+         bool bContinue = (tokenStream.Peek().nType != Token::TOKEN_ARRAY_END);
+         while (bContinue)
+         {
+            Parse(handler, tokenStream);
+            if (handler.Stopped())
+               return;
+
+            bContinue = (tokenStream.Peek().nType == Token::TOKEN_NEXT_ELEMENT);
+            if (bContinue)
+               MatchExpectedToken(Token::TOKEN_NEXT_ELEMENT, tokenStream);
+         }
+         MatchExpectedToken(Token::TOKEN_ARRAY_END, tokenStream);
+         handler.EndArray();
+         break;
+      }
+
+      case Token::TOKEN_STRING:
+         handler.StringValue(token.sValue);
+         break;
+
+      case Token::TOKEN_NUMBER:
+         handler.NumberValue(ConvertNumber(token));
+         break;
+
+      case Token::TOKEN_BOOLEAN:
+         handler.BooleanValue(token.sValue == "true");
+         break;
+
+      case Token::TOKEN_NULL:
+         handler.NullValue();
+         break;
+
+      default:
+      {
+         std::string sMessage = std::string("Unexpected token: ") + token.sValue;
+         throw ParseException(sMessage, token.locBegin, token.locEnd);
+      }
+   }
+}
+
+
+inline const std::string& Reader::MatchExpectedToken(Token::Type nExpected, Reader::LazyTokenStream& tokenStream)
+{
+   const Token& token = tokenStream.Get();
+   if (token.nType != nExpected)
+   {
+      std::string sMessage = std::string("Unexpected token: ") + token.sValue;
+      throw ParseException(sMessage, token.locBegin, token.locEnd);
+   }
+
+   return token.sValue;
+}
+
+
 inline const std::string& Reader::MatchExpectedToken(Token::Type nExpected, Reader::TokenStream& tokenStream)
 {
    const Token& token = tokenStream.Get();
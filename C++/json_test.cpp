@@ -0,0 +1,304 @@
+// Tests for the changes made to the bundled Cajun JSON library (json/).
+//
+//   json_test
+//
+// Prints every check that fails, and exits with status 1 if any did. `make
+// check` runs it.
+
+#include "json/elements.h"
+#include "json/reader.h"
+
+#include <cstdio>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <utility>
+
+using namespace json;
+using namespace std;
+
+static int checks = 0;
+static int failures = 0;
+
+#define CHECK(condition)                                                    \
+  do {                                                                      \
+    checks++;                                                               \
+    if (!(condition)) {                                                     \
+      failures++;                                                           \
+      fprintf(stderr, "%s:%d: failed: %s\n", __FILE__, __LINE__, #condition); \
+    }                                                                       \
+  } while (0)
+
+static string member_name(int k) {
+  ostringstream name;
+  name << "member" << k;
+  return name.str();
+}
+
+// Whether `object` has members 0..count-1, except those for which `missing`
+// is true, each holding its own number, and nothing else.
+template <typename Missing>
+static bool has_members(const Object& object, int count, Missing missing) {
+  size_t present = 0;
+  for (int k = 0; k < count; k++) {
+    Object::const_iterator it = object.Find(member_name(k));
+    if (missing(k)) {
+      if (it != object.End()) {
+        return false;
+      }
+      continue;
+    }
+    if (it == object.End() || it->name != member_name(k) ||
+        (double)(const Number&)it->element != k) {
+      return false;
+    }
+    present++;
+  }
+  return object.Size() == present && object.Find("absent") == object.End();
+}
+
+static bool none_missing(int) {
+  return false;
+}
+
+// Large enough that lookups go through the hash index, which is only built
+// for objects of 8 members or more.
+#define LARGE 100
+
+static void fill(Object* object, int count) {
+  for (int k = 0; k < count; k++) {
+    object->Insert(Object::Member(member_name(k), Number(k)));
+  }
+}
+
+static void test_object_index() {
+  // Inserting one member at a time, growing the index as it goes.
+  Object object;
+  for (int k = 0; k < LARGE; k++) {
+    object.Insert(Object::Member(member_name(k), Number(k)));
+    CHECK(has_members(object, k + 1, none_missing));
+  }
+  // Insertion order is kept for writing.
+  int k = 0;
+  for (Object::const_iterator it = object.Begin(); it != object.End(); ++it, ++k) {
+    CHECK(it->name == member_name(k));
+  }
+
+  // Inserting a copy of a member, and through operator[].
+  Object::Member extra("extra", Number(-1));
+  object.Insert(extra);
+  CHECK(object.Find("extra") != object.End());
+  object["another"] = Number(-2);
+  CHECK((double)(Number&)object["another"] == -2);
+  CHECK(object.Size() == LARGE + 2);
+
+  // Inserting a name that's already there throws, and changes nothing.
+  bool threw = false;
+  try {
+    object.Insert(Object::Member(member_name(7), Number(0)));
+  } catch (const Exception&) {
+    threw = true;
+  }
+  CHECK(threw);
+  CHECK((double)(Number&)object[member_name(7)] == 7);
+
+  // Erasing members, then looking up the ones left and the ones gone.
+  object.Erase(object.Find("extra"));
+  object.Erase(object.Find("another"));
+  for (int k = 0; k < LARGE; k += 3) {
+    object.Erase(object.Find(member_name(k)));
+  }
+  auto every_third = [](int k) { return k % 3 == 0; };
+  CHECK(has_members(object, LARGE, every_third));
+  // And inserting after the erasures.
+  object.Insert(Object::Member(member_name(0), Number(0)));
+  auto every_third_but_first = [](int k) { return k % 3 == 0 && k != 0; };
+  CHECK(has_members(object, LARGE, every_third_but_first));
+
+  // Copy-assigning over an object whose index was already built.
+  Object copy;
+  fill(&copy, 20);
+  CHECK(copy.Find(member_name(5)) != copy.End());
+  copy = object;
+  CHECK(has_members(copy, LARGE, every_third_but_first));
+  CHECK(has_members(object, LARGE, every_third_but_first));
+  // The copy finds its own members, not the original's.
+  Object::iterator found = copy.Find(member_name(1));
+  CHECK(found != copy.End() && &found->element != &object.Find(member_name(1))->element);
+  copy.Erase(copy.Find(member_name(1)));
+  CHECK(copy.Find(member_name(1)) == copy.End());
+  CHECK(object.Find(member_name(1)) != object.End());
+  copy = copy;
+  CHECK(copy.Size() == object.Size() - 1);
+
+  // Copy-constructing.
+  Object constructed(object);
+  CHECK(has_members(constructed, LARGE, every_third_but_first));
+
+  // Moving, and moving over an object with an index.
+  Object moved(std::move(constructed));
+  CHECK(has_members(moved, LARGE, every_third_but_first));
+  CHECK(constructed.Size() == 0 && constructed.Find(member_name(2)) == constructed.End());
+  Object target;
+  fill(&target, 30);
+  CHECK(target.Find(member_name(29)) != target.End());
+  target = std::move(moved);
+  CHECK(has_members(target, LARGE, every_third_but_first));
+  CHECK(moved.Size() == 0 && moved.Find(member_name(2)) == moved.End());
+  // A moved-from object can be filled again.
+  fill(&moved, LARGE);
+  CHECK(has_members(moved, LARGE, none_missing));
+
+  // An object read from text, looked up through its index.
+  ostringstream text;
+  text << "{";
+  for (int k = 0; k < LARGE; k++) {
+    text << (k ? ", " : "") << "\"" << member_name(k) << "\": " << k;
+  }
+  text << "}";
+  istringstream in(text.str());
+  Object read;
+  Reader::Read(read, in);
+  CHECK(has_members(read, LARGE, none_missing));
+
+  object.Clear();
+  CHECK(object.Size() == 0 && object.Find(member_name(2)) == object.End());
+}
+
+// Writes each callback as a short token, so a test can compare the whole
+// sequence at once.
+class RecordingHandler : public Reader::Handler {
+ public:
+  // Calls Stop from the callback that writes event number `stop_after`
+  // (counting from 1), if it's positive.
+  explicit RecordingHandler(int stop_after = 0) : stop_after_(stop_after), count_(0) {}
+
+  string events;
+
+  virtual void BeginObject() { record("{"); }
+  virtual void MemberName(const string& name) { record(name + ":"); }
+  virtual void EndObject() { record("}"); }
+  virtual void BeginArray() { record("["); }
+  virtual void EndArray() { record("]"); }
+  virtual void StringValue(const string& value) { record("\"" + value + "\""); }
+  virtual void NumberValue(double value) {
+    ostringstream text;
+    text << value;
+    record(text.str());
+  }
+  virtual void BooleanValue(bool value) { record(value ? "true" : "false"); }
+  virtual void NullValue() { record("null"); }
+
+ private:
+  void record(const string& event) {
+    events += (events.empty() ? "" : " ") + event;
+    if (++count_ == stop_after_) {
+      Stop();
+    }
+  }
+
+  int stop_after_;
+  int count_;
+};
+
+// Whether reading `text` with a handler throws a json::Exception.
+static bool sax_throws(const string& text) {
+  istringstream in(text);
+  RecordingHandler handler;
+  try {
+    Reader::Read(handler, in);
+  } catch (const Exception&) {
+    return true;
+  }
+  return false;
+}
+
+static void test_sax() {
+  // Several documents back to back, read one at a time.
+  istringstream in("{\"a\": 1, \"b\": {}} [2, [], \"x\"]\"y\"-4.5e1 true false null  \n ");
+  const char* expected[] = {"{ a: 1 b: { } }", "[ 2 [ ] \"x\" ]", "\"y\"", "-45", "true", "false",
+                            "null"};
+  for (size_t k = 0; k < sizeof expected / sizeof *expected; k++) {
+    RecordingHandler handler;
+    CHECK(Reader::Read(handler, in));
+    CHECK(handler.events == expected[k]);
+  }
+  RecordingHandler empty;
+  CHECK(!Reader::Read(empty, in));
+  CHECK(empty.events.empty());
+
+  // Stopping partway, from each kind of callback. The rest of the document
+  // is left unread, starting just past the token the handler stopped at.
+  struct {
+    int stop_after;
+    const char* events;
+    const char* rest;
+  } stops[] = {
+      {1, "{", "\"a\": [1, {\"b\": null}], \"c\": 2} 7"},
+      {2, "{ a:", ": [1, {\"b\": null}], \"c\": 2} 7"},
+      {3, "{ a: [", "1, {\"b\": null}], \"c\": 2} 7"},
+      {4, "{ a: [ 1", ", {\"b\": null}], \"c\": 2} 7"},
+      {7, "{ a: [ 1 { b: null", "}], \"c\": 2} 7"},
+      {8, "{ a: [ 1 { b: null }", "], \"c\": 2} 7"},
+      {9, "{ a: [ 1 { b: null } ]", ", \"c\": 2} 7"},
+      {12, "{ a: [ 1 { b: null } ] c: 2 }", " 7"},
+  };
+  for (size_t k = 0; k < sizeof stops / sizeof *stops; k++) {
+    istringstream in("{\"a\": [1, {\"b\": null}], \"c\": 2} 7");
+    RecordingHandler handler(stops[k].stop_after);
+    CHECK(Reader::Read(handler, in));
+    CHECK(handler.Stopped());
+    CHECK(handler.events == stops[k].events);
+    string rest((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    CHECK(rest == stops[k].rest);
+  }
+  // Reading again with a handler that stopped starts it over.
+  istringstream twice("[1] [3]");
+  RecordingHandler stopping(3);
+  CHECK(Reader::Read(stopping, twice));
+  CHECK(stopping.Stopped() && stopping.events == "[ 1 ]");
+  stopping.events.clear();
+  CHECK(Reader::Read(stopping, twice));
+  CHECK(!stopping.Stopped() && stopping.events == "[ 3 ]");
+
+  // Malformed input at every kind of token.
+  const char* malformed[] = {
+      "{",              // unclosed object
+      "{\"a\" 1}",       // missing ':'
+      "{1: 2}",         // member name not a string
+      "{\"a\": 1 \"b\": 2}", // missing ','
+      "{\"a\": 1,}",     // ',' before '}'
+      "{\"a\":}",        // missing member value
+      "[1 2]",          // missing ','
+      "[1,]",           // ',' before ']'
+      "[",              // unclosed array
+      "[1}",            // mismatched close
+      "]",              // unexpected ']'
+      "}",              // unexpected '}'
+      ":",              // unexpected ':'
+      ",",              // unexpected ','
+      "\"abc",          // unterminated string
+      "\"\\q\"",          // bad escape
+      "tru",            // truncated true
+      "fals",           // truncated false
+      "nul",            // truncated null
+      "nil",            // not a keyword
+      "-",              // number with no digits
+      "1.2.3",          // number with characters left over
+      "@",              // no token starts with this
+  };
+  for (size_t k = 0; k < sizeof malformed / sizeof *malformed; k++) {
+    bool threw = sax_throws(malformed[k]);
+    CHECK(threw);
+    if (!threw) {
+      fprintf(stderr, "  didn't throw on: %s\n", malformed[k]);
+    }
+  }
+}
+
+int main() {
+  test_object_index();
+  test_sax();
+  printf("%d checks, %d failed\n", checks, failures);
+  return failures ? 1 : 0;
+}
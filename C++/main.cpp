@@ -0,0 +1,74 @@
+#include "dropblox_ai.h"
+#include "state_binary.h"
+#include "state_input.h"
+#include "state_parser.h"
+#include "turn_stats.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+using namespace std;
+
+// The file descriptor named by DROPBLOX_STATS_FD, or -1 if it's unset.
+static int stats_fd() {
+  const char* value = getenv("DROPBLOX_STATS_FD");
+  return value && *value ? atoi(value) : -1;
+}
+
+// Whether DROPBLOX_PERF_COUNTERS asks for hardware counters in the stats.
+static bool perf_counters_wanted() {
+  const char* value = getenv("DROPBLOX_PERF_COUNTERS");
+  return value && *value && strcmp(value, "0") != 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    cerr << "Usage: " << argv[0] << " <state JSON | - | @state-file> [seconds remaining]" << endl;
+    return 1;
+  }
+
+  int fd = stats_fd();
+  TurnStats stats;
+  if (argc > 2) {
+    stats.seconds_allowed = atof(argv[2]);
+  }
+  PerfCounters* perf = NULL;
+  if (fd >= 0 && perf_counters_wanted()) {
+    perf = new PerfCounters();
+    stats.perf = perf;
+  }
+  PhaseClock clock(fd >= 0 ? &stats : NULL);
+  clock.next(PHASE_PARSE);
+
+  // Parse the game state straight out of wherever it came from. States
+  // starting with the binary magic are in the format from state_binary.h.
+  StateInput input(argv[1]);
+  GameState state;
+  if (is_binary_state(input.begin(), input.end())) {
+    parse_binary_state(input.begin(), input.end(), &state);
+  } else {
+    parse_game_state(input.begin(), input.end(), &state);
+  }
+
+  clock.stop();
+
+  vector<string> moves;
+  moves = play_any(state, fd >= 0 ? &stats : NULL);
+  // Ignore the last move, because it moved the block into invalid
+  // position. Make all the rest.
+  for (int i = 0; i < moves.size(); i++) {
+    cout << moves[i] << endl;
+  }
+
+  if (fd >= 0) {
+    // One write, so lines from concurrent turns don't interleave.
+    ostringstream line;
+    write_turn_stats(stats, state.rows, state.cols, line);
+    string text = line.str();
+    if (write(fd, text.data(), text.size()) != (ssize_t)text.size()) {
+      cerr << "Couldn't write turn stats to fd " << fd << endl;
+    }
+  }
+  delete perf;
+}
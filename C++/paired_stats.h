@@ -0,0 +1,56 @@
+#ifndef PAIRED_STATS_H_
+#define PAIRED_STATS_H_
+
+#include <cmath>
+
+// Compares two players by the scores they made on the same games, that is on
+// the same seeds. Games played on the same blocks differ far less than games
+// on different blocks, so the difference between the players shows up after
+// far fewer games than it would comparing their means alone.
+
+// Games both players must have played before a difference counts.
+#define MIN_PAIRED_GAMES 8
+
+// The mean of a[g] - b[g] over n games, and its standard error.
+struct PairedDifference {
+  int games;
+  double mean;
+  double standard_error;
+};
+
+inline PairedDifference paired_difference(const int* a, const int* b, int n) {
+  PairedDifference difference = {n, 0, 0};
+  if (n == 0) {
+    return difference;
+  }
+  for (int g = 0; g < n; g++) {
+    difference.mean += a[g] - b[g];
+  }
+  difference.mean /= n;
+  if (n > 1) {
+    double variance = 0;
+    for (int g = 0; g < n; g++) {
+      double d = a[g] - b[g] - difference.mean;
+      variance += d * d;
+    }
+    variance /= n - 1;
+    difference.standard_error = sqrt(variance / n);
+  }
+  return difference;
+}
+
+// Whether the difference is above zero by more than `z` standard errors,
+// over enough games to trust the estimate.
+inline bool significantly_positive(const PairedDifference& difference, double z) {
+  return difference.games >= MIN_PAIRED_GAMES &&
+         difference.mean - z * difference.standard_error > 0;
+}
+
+// Whether the difference is away from zero, either way, by more than `z`
+// standard errors.
+inline bool significant(const PairedDifference& difference, double z) {
+  return difference.games >= MIN_PAIRED_GAMES &&
+         fabs(difference.mean) - z * difference.standard_error > 0;
+}
+
+#endif  // PAIRED_STATS_H_
@@ -0,0 +1,184 @@
+#ifndef PERF_COUNTERS_H_
+#define PERF_COUNTERS_H_
+
+#include <stdint.h>
+#include <string>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Hardware performance counters for this thread, read through
+// perf_event_open on Linux. Counting is limited to user space, which is all
+// an unprivileged process may count under the default perf_event_paranoid
+// setting. Elsewhere, and on machines without a usable PMU (many VMs), no
+// counter opens and available() is false.
+//
+// When there are more counters than the PMU has registers, the kernel takes
+// turns scheduling them, and each counts only part of the time. Each
+// reading keeps the raw counts along with how long the group had been
+// enabled and running, and perf_delta scales the counts between two
+// readings by that interval's own ratio, the way perf stat does, so the
+// counts are estimates in that case.
+
+enum PerfCounter {
+  PERF_CYCLES = 0,
+  PERF_INSTRUCTIONS,
+  PERF_CACHE_MISSES,
+  PERF_BRANCH_MISSES,
+  NUM_PERF_COUNTERS
+};
+
+static const char* const PERF_COUNTER_NAMES[NUM_PERF_COUNTERS] = {
+  "cycles",
+  "instructions",
+  "cache_misses",
+  "branch_misses",
+};
+
+// One reading of the group: each counter's raw running total, and the
+// group's total time enabled and time actually counting, in nanoseconds.
+struct PerfReading {
+  uint64_t values[NUM_PERF_COUNTERS];
+  uint64_t enabled;
+  uint64_t running;
+};
+
+// What each counter counted between readings `start` and `end`, scaled up
+// to the whole time the group was enabled in between. Returns false if the
+// group never ran in between, so there is nothing to scale.
+inline bool perf_delta(const PerfReading& start, const PerfReading& end,
+                       uint64_t delta[NUM_PERF_COUNTERS]) {
+  if (end.running <= start.running || end.enabled < start.enabled) {
+    return false;
+  }
+  uint64_t enabled = end.enabled - start.enabled;
+  uint64_t running = end.running - start.running;
+  double scale = running < enabled ? (double)enabled / running : 1;
+  for (int c = 0; c < NUM_PERF_COUNTERS; c++) {
+    uint64_t counted = end.values[c] >= start.values[c] ? end.values[c] - start.values[c] : 0;
+    delta[c] = (uint64_t)(counted * scale);
+  }
+  return true;
+}
+
+class PerfCounters {
+ public:
+  // Opens every counter the machine has, as one group, so they're all
+  // scheduled together and read with a single system call.
+  PerfCounters() : leader(-1), opened(0) {
+    for (int c = 0; c < NUM_PERF_COUNTERS; c++) {
+      fds[c] = -1;
+      slot[c] = -1;
+    }
+#ifdef __linux__
+    static const uint64_t CONFIGS[NUM_PERF_COUNTERS] = {
+      PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES,
+      PERF_COUNT_HW_BRANCH_MISSES,
+    };
+    for (int c = 0; c < NUM_PERF_COUNTERS; c++) {
+      struct perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = CONFIGS[c];
+      attr.read_format =
+          PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      attr.disabled = leader < 0;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+      if (fd < 0) {
+        if (error.empty()) {
+          error = std::string(PERF_COUNTER_NAMES[c]) + ": " + strerror(errno);
+        }
+        continue;
+      }
+      if (leader < 0) {
+        leader = fd;
+      }
+      fds[c] = fd;
+      slot[c] = opened++;
+    }
+    if (leader >= 0) {
+      ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#else
+    error = "perf_event_open is Linux-only";
+#endif
+  }
+
+  ~PerfCounters() {
+#ifdef __linux__
+    for (int c = 0; c < NUM_PERF_COUNTERS; c++) {
+      if (fds[c] >= 0) {
+        close(fds[c]);
+      }
+    }
+#endif
+  }
+
+  // Whether any counter opened.
+  bool available() const { return opened > 0; }
+
+  // Whether counter `c` opened.
+  bool has(int c) const { return slot[c] >= 0; }
+
+  // Why the first counter that didn't open didn't, or "" if they all did.
+  const std::string& get_error() const { return error; }
+
+  // Reads every counter's raw running total, and the group's times, into
+  // `reading`. Counters that didn't open read as 0. Returns false if they
+  // couldn't be read.
+  bool read_all(PerfReading* reading) const {
+    for (int c = 0; c < NUM_PERF_COUNTERS; c++) {
+      reading->values[c] = 0;
+    }
+    reading->enabled = reading->running = 0;
+#ifdef __linux__
+    if (leader < 0) {
+      return false;
+    }
+    // The group's read format: the number of counters, the time the group
+    // was enabled and the time it was actually counting, in nanoseconds,
+    // then the counters' values in the order they joined.
+    uint64_t buffer[3 + NUM_PERF_COUNTERS];
+    ssize_t size = read(leader, buffer, sizeof(buffer));
+    if (size < (ssize_t)(3 * sizeof(uint64_t)) || buffer[0] != (uint64_t)opened ||
+        size < (ssize_t)((3 + opened) * sizeof(uint64_t))) {
+      return false;
+    }
+    reading->enabled = buffer[1];
+    reading->running = buffer[2];
+    for (int c = 0; c < NUM_PERF_COUNTERS; c++) {
+      if (slot[c] >= 0) {
+        reading->values[c] = buffer[3 + slot[c]];
+      }
+    }
+    return true;
+#else
+    return false;
+#endif
+  }
+
+ private:
+  int fds[NUM_PERF_COUNTERS];
+  // Where each counter's value is in a group read, or -1 if it didn't open.
+  int slot[NUM_PERF_COUNTERS];
+  int leader;
+  int opened;
+  std::string error;
+
+  PerfCounters(const PerfCounters&);
+  PerfCounters& operator=(const PerfCounters&);
+};
+
+#endif  // PERF_COUNTERS_H_
@@ -0,0 +1,213 @@
+// Counts the placements the engine generates from a state, ply by ply down
+// the preview, like a chess engine's perft.
+//
+//   perft [--depth D] [--divide] [--distinct] <state JSON | - | @state-file>
+//
+// places the block every way generate_placements allows, then the first
+// preview block every way on each resulting board, and so on for D plies
+// (default 2, and at most one more than the preview's length). It prints the
+// number of placements at each ply, and the placements per second over the
+// whole tree.
+//
+// --divide prints the number of placements at the last ply under each first
+// placement too, to narrow down where two builds differ. --distinct also
+// counts the distinct boards at each ply, in a separate, untimed pass.
+//
+// The counts depend only on the state and on how placements are generated,
+// so a faster generator must reproduce them exactly.
+
+#include "dropblox_ai.h"
+#include "engine.h"
+#include "state_binary.h"
+#include "state_input.h"
+#include "state_parser.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <set>
+
+using namespace std;
+
+static void usage(const char* name) {
+  cerr << "Usage: " << name << " [--depth D] [--divide] [--distinct]"
+       << " <state JSON | - | @state-file>" << endl;
+  exit(1);
+}
+
+// The boards and placements at each ply of the walk, allocated up front.
+template <int ROWS, int COLS>
+struct PerftScratch {
+  vector<BasicBoard<ROWS, COLS> > boards;
+  vector<vector<Placement> > placements;
+  // counts[ply] is the number of placements made at that ply, from 0.
+  vector<long> counts;
+  // With --distinct, the boards reached at each ply.
+  vector<set<string> > distinct;
+
+  explicit PerftScratch(int depth)
+      : boards(depth), placements(depth), counts(depth), distinct(depth) {
+    for (int ply = 0; ply < depth; ply++) {
+      placements[ply].reserve(8 * COLS);
+    }
+  }
+};
+
+template <int ROWS, int COLS>
+string board_key(const BasicBoard<ROWS, COLS>& board) {
+  return string((const char*)board.row_masks, sizeof(board.row_masks));
+}
+
+// Places the board's block every way and recurses on each result, down to
+// ply `depth - 1`. Returns the number of placements made at the last ply.
+template <int ROWS, int COLS>
+long perft(const BasicBoard<ROWS, COLS>& board, int ply, int depth, bool distinct,
+           PerftScratch<ROWS, COLS>* scratch) {
+  vector<Placement>& placements = scratch->placements[ply];
+  placements.clear();
+  generate_placements(board, &placements);
+  scratch->counts[ply] += placements.size();
+  if (ply + 1 == depth && !distinct) {
+    return placements.size();
+  }
+
+  BasicBoard<ROWS, COLS>& child = scratch->boards[ply];
+  long leaves = 0;
+  for (size_t k = 0; k < placements.size(); k++) {
+    Point translation = {0, placements[k].translation};
+    Point landing;
+    board.place_into(*board.block, translation, placements[k].rotation, &child, &landing);
+    if (distinct) {
+      scratch->distinct[ply].insert(board_key(child));
+    }
+    if (ply + 1 == depth) {
+      leaves++;
+    } else {
+      leaves += perft(child, ply + 1, depth, distinct, scratch);
+    }
+  }
+  return leaves;
+}
+
+// The commands pick_move would send for a placement.
+static string describe(const Placement& placement) {
+  string text;
+  for (int k = 0; k < placement.rotation; k++) {
+    text += "rotate ";
+  }
+  int steps = abs(placement.translation);
+  for (int k = 0; k < steps; k++) {
+    text += placement.translation < 0 ? "left " : "right ";
+  }
+  return text.empty() ? "(no moves)" : text.substr(0, text.size() - 1);
+}
+
+template <int ROWS, int COLS>
+void run_perft(const GameState& state, int depth, bool divide, bool distinct) {
+  BasicBoard<ROWS, COLS> board(state);
+  int most = 1 + board.preview.size();
+  if (depth > most) {
+    cerr << "The preview only allows a depth of " << most << endl;
+    exit(1);
+  }
+
+  typedef chrono::steady_clock Clock;
+  PerftScratch<ROWS, COLS> scratch(depth);
+  Clock::time_point start = Clock::now();
+  long leaves = perft(board, 0, depth, false, &scratch);
+  double elapsed = chrono::duration<double>(Clock::now() - start).count();
+
+  long nodes = 0;
+  for (int ply = 0; ply < depth; ply++) {
+    nodes += scratch.counts[ply];
+  }
+  PerftScratch<ROWS, COLS> distinct_scratch(depth);
+  if (distinct) {
+    perft(board, 0, depth, true, &distinct_scratch);
+  }
+  for (int ply = 0; ply < depth; ply++) {
+    printf("ply %d: %ld placements", ply + 1, scratch.counts[ply]);
+    if (distinct) {
+      printf(", %zu distinct boards", distinct_scratch.distinct[ply].size());
+    }
+    printf("\n");
+  }
+  printf("%ld placements in %.6fs: %.0f placements/s\n", nodes, elapsed,
+         elapsed > 0 ? nodes / elapsed : 0.0);
+
+  if (divide) {
+    vector<Placement> roots;
+    generate_placements(board, &roots);
+    BasicBoard<ROWS, COLS> child;
+    PerftScratch<ROWS, COLS> divide_scratch(depth);
+    long total = 0;
+    for (size_t k = 0; k < roots.size(); k++) {
+      long count = 1;
+      if (depth > 1) {
+        Point translation = {0, roots[k].translation};
+        Point landing;
+        board.place_into(*board.block, translation, roots[k].rotation, &child, &landing);
+        count = perft(child, 1, depth, false, &divide_scratch);
+      }
+      total += count;
+      printf("%s: %ld\n", describe(roots[k]).c_str(), count);
+    }
+    if (total != leaves) {
+      cerr << "Divided counts add up to " << total << ", not " << leaves << endl;
+      exit(1);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  int depth = 2;
+  bool divide = false;
+  bool distinct = false;
+  const char* source = NULL;
+  for (int k = 1; k < argc; k++) {
+    if (strcmp(argv[k], "--depth") == 0 && k + 1 < argc) {
+      depth = atoi(argv[++k]);
+    } else if (strcmp(argv[k], "--divide") == 0) {
+      divide = true;
+    } else if (strcmp(argv[k], "--distinct") == 0) {
+      distinct = true;
+    } else if (!source) {
+      source = argv[k];
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (!source || depth < 1) {
+    usage(argv[0]);
+  }
+
+  engine_debug = false;
+  try {
+    StateInput input(source);
+    GameState state;
+    if (is_binary_state(input.begin(), input.end())) {
+      parse_binary_state(input.begin(), input.end(), &state);
+    } else {
+      parse_game_state(input.begin(), input.end(), &state);
+    }
+    if (!state.block) {
+      cerr << "The state has no block to place" << endl;
+      return 1;
+    }
+
+#define PERFT_GEOMETRY(R, C) \
+    if (state.rows == R && state.cols == C) { \
+      run_perft<R, C>(state, depth, divide, distinct); \
+      return 0; \
+    }
+    FOR_EACH_GEOMETRY(PERFT_GEOMETRY)
+#undef PERFT_GEOMETRY
+
+    cerr << "Unsupported board geometry " << state.rows << "x" << state.cols << endl;
+  } catch (const Exception& e) {
+    cerr << e.what() << endl;
+  }
+  return 1;
+}
@@ -0,0 +1,273 @@
+#ifndef PIECE_CATALOG_H_
+#define PIECE_CATALOG_H_
+
+#include <stdint.h>
+#include <initializer_list>
+
+// The server only ever sends a small, fixed set of shapes, so everything we
+// need to know about them - the cells of each rotation, their bounding boxes
+// and their row masks - is worked out at compile time. A block read from the
+// game state is matched against this catalog once. Blocks that don't match
+// get the same tables built at runtime, as long as they fit in a ShapeTable;
+// anything bigger falls back to rotating its offsets cell by cell.
+
+#define MAX_SHAPE_CELLS 16
+#define MAX_SHAPE_SPAN 16
+#define NO_SHAPE -1
+
+struct ShapeCell {
+  int i;
+  int j;
+};
+
+// One rotation of a shape. The fields Board::check reads come first, so a
+// check only touches the first cache line.
+struct ShapeRotation {
+  // The top-left corner of the cells' bounding box, and its size.
+  int min_i;
+  int min_j;
+  int height;
+  int width;
+  // rows[k] has bit b set if (min_i + k, min_j + b) is one of the cells.
+  uint16_t rows[MAX_SHAPE_SPAN];
+  // The cells, relative to the block's center, after rotating the shape's
+  // base cells this many quarter turns the same way Board::check does.
+  ShapeCell cells[MAX_SHAPE_CELLS];
+  // A translation-independent fingerprint of the cells, used for matching.
+  uint64_t key;
+};
+
+struct ShapeTable {
+  int size;
+  ShapeRotation rotations[4];
+};
+
+// Rotates a cell by `rotation` quarter turns, matching the convention used
+// by Board::check.
+constexpr ShapeCell rotate_cell(ShapeCell cell, int rotation) {
+  switch (rotation & 3) {
+    case 1:
+      return ShapeCell{cell.j, -cell.i};
+    case 2:
+      return ShapeCell{-cell.i, -cell.j};
+    case 3:
+      return ShapeCell{-cell.j, cell.i};
+    default:
+      return cell;
+  }
+}
+
+// Packs cells into an 8x8 occupancy mask after shifting them so that their
+// bounding box starts at (0, 0). Returns 0 if they don't fit.
+constexpr uint64_t shape_key(const ShapeCell* cells, int size) {
+  int min_i = cells[0].i;
+  int min_j = cells[0].j;
+  for (int k = 1; k < size; k++) {
+    if (cells[k].i < min_i) min_i = cells[k].i;
+    if (cells[k].j < min_j) min_j = cells[k].j;
+  }
+  uint64_t key = 0;
+  for (int k = 0; k < size; k++) {
+    int i = cells[k].i - min_i;
+    int j = cells[k].j - min_j;
+    if (i >= 8 || j >= 8) {
+      return 0;
+    }
+    key |= (uint64_t)1 << (8 * i + j);
+  }
+  return key;
+}
+
+// Builds the table for one rotation. The cells must fit in a ShapeRotation;
+// see shape_fits.
+constexpr ShapeRotation make_rotation(const ShapeCell* base, int size, int rotation) {
+  ShapeRotation result{};
+  for (int k = 0; k < size; k++) {
+    result.cells[k] = rotate_cell(base[k], rotation);
+  }
+  result.min_i = result.cells[0].i;
+  result.min_j = result.cells[0].j;
+  int max_i = result.min_i;
+  int max_j = result.min_j;
+  for (int k = 1; k < size; k++) {
+    if (result.cells[k].i < result.min_i) result.min_i = result.cells[k].i;
+    if (result.cells[k].j < result.min_j) result.min_j = result.cells[k].j;
+    if (result.cells[k].i > max_i) max_i = result.cells[k].i;
+    if (result.cells[k].j > max_j) max_j = result.cells[k].j;
+  }
+  result.height = max_i - result.min_i + 1;
+  result.width = max_j - result.min_j + 1;
+  for (int k = 0; k < size; k++) {
+    result.rows[result.cells[k].i - result.min_i] |=
+        (uint16_t)(1 << (result.cells[k].j - result.min_j));
+  }
+  result.key = shape_key(result.cells, size);
+  return result;
+}
+
+constexpr ShapeTable make_shape(const ShapeCell* base, int size) {
+  ShapeTable shape{};
+  shape.size = size;
+  for (int rotation = 0; rotation < 4; rotation++) {
+    shape.rotations[rotation] = make_rotation(base, size, rotation);
+  }
+  return shape;
+}
+
+constexpr ShapeTable make_shape(std::initializer_list<ShapeCell> base) {
+  return make_shape(base.begin(), (int)base.size());
+}
+
+// Returns true if the cells can be described by a ShapeTable.
+constexpr bool shape_fits(const ShapeCell* cells, int size) {
+  if (size <= 0 || size > MAX_SHAPE_CELLS) {
+    return false;
+  }
+  int min_i = cells[0].i, max_i = cells[0].i;
+  int min_j = cells[0].j, max_j = cells[0].j;
+  for (int k = 1; k < size; k++) {
+    if (cells[k].i < min_i) min_i = cells[k].i;
+    if (cells[k].i > max_i) max_i = cells[k].i;
+    if (cells[k].j < min_j) min_j = cells[k].j;
+    if (cells[k].j > max_j) max_j = cells[k].j;
+  }
+  return max_i - min_i < MAX_SHAPE_SPAN && max_j - min_j < MAX_SHAPE_SPAN;
+}
+
+// Every free polyomino of up to five cells, together with its mirror image
+// where that differs. Rotations are generated, so each shape appears once.
+//
+// The binary state format (state_binary.h) stores shapes as indices into
+// this array, so adding, removing, reordering or editing a shape changes
+// what existing files decode to. Any such change needs BINARY_STATE_VERSION
+// bumped; a static_assert on catalog_hash() there stops the build until it
+// is.
+constexpr ShapeTable PIECE_CATALOG[] = {
+  // monomino and domino
+  make_shape({{0, 0}}),
+  make_shape({{0, 0}, {0, 1}}),
+  // trominoes
+  make_shape({{0, 0}, {0, 1}, {0, 2}}),
+  make_shape({{0, 0}, {1, 0}, {1, 1}}),
+  // tetrominoes: I, O, T, S, Z, L, J
+  make_shape({{0, 0}, {0, 1}, {0, 2}, {0, 3}}),
+  make_shape({{0, 0}, {0, 1}, {1, 0}, {1, 1}}),
+  make_shape({{0, 0}, {0, 1}, {0, 2}, {1, 1}}),
+  make_shape({{0, 1}, {0, 2}, {1, 0}, {1, 1}}),
+  make_shape({{0, 0}, {0, 1}, {1, 1}, {1, 2}}),
+  make_shape({{0, 0}, {0, 1}, {0, 2}, {1, 0}}),
+  make_shape({{0, 0}, {0, 1}, {0, 2}, {1, 2}}),
+  // pentominoes: F, I, L, N, P, T, U, V, W, X, Y, Z and the mirrored F, L,
+  // N, P, Y and Z
+  make_shape({{0, 1}, {0, 2}, {1, 0}, {1, 1}, {2, 1}}),
+  make_shape({{0, 0}, {0, 1}, {0, 2}, {0, 3}, {0, 4}}),
+  make_shape({{0, 0}, {0, 1}, {0, 2}, {0, 3}, {1, 0}}),
+  make_shape({{0, 0}, {0, 1}, {1, 1}, {1, 2}, {1, 3}}),
+  make_shape({{0, 0}, {0, 1}, {0, 2}, {1, 0}, {1, 1}}),
+  make_shape({{0, 0}, {0, 1}, {0, 2}, {1, 1}, {2, 1}}),
+  make_shape({{0, 0}, {0, 2}, {1, 0}, {1, 1}, {1, 2}}),
+  make_shape({{0, 0}, {1, 0}, {2, 0}, {2, 1}, {2, 2}}),
+  make_shape({{0, 0}, {1, 0}, {1, 1}, {2, 1}, {2, 2}}),
+  make_shape({{0, 1}, {1, 0}, {1, 1}, {1, 2}, {2, 1}}),
+  make_shape({{0, 0}, {0, 1}, {0, 2}, {0, 3}, {1, 1}}),
+  make_shape({{0, 0}, {0, 1}, {1, 1}, {2, 1}, {2, 2}}),
+  make_shape({{0, 0}, {0, 1}, {1, 1}, {1, 2}, {2, 1}}),
+  make_shape({{0, 0}, {0, 1}, {0, 2}, {0, 3}, {1, 3}}),
+  make_shape({{0, 2}, {0, 3}, {1, 0}, {1, 1}, {1, 2}}),
+  make_shape({{0, 0}, {0, 1}, {0, 2}, {1, 1}, {1, 2}}),
+  make_shape({{0, 0}, {0, 1}, {0, 2}, {0, 3}, {1, 2}}),
+  make_shape({{0, 1}, {0, 2}, {1, 1}, {2, 0}, {2, 1}}),
+};
+
+constexpr int CATALOG_SIZE = sizeof(PIECE_CATALOG) / sizeof(PIECE_CATALOG[0]);
+
+// An FNV-1a hash of every shape's base cells, in catalog order, which
+// changes whenever the catalog does.
+constexpr uint64_t catalog_hash() {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (int shape = 0; shape < CATALOG_SIZE; shape++) {
+    const ShapeRotation& base = PIECE_CATALOG[shape].rotations[0];
+    int values[1 + 2 * MAX_SHAPE_CELLS] = {PIECE_CATALOG[shape].size};
+    for (int k = 0; k < PIECE_CATALOG[shape].size; k++) {
+      values[1 + 2 * k] = base.cells[k].i;
+      values[2 + 2 * k] = base.cells[k].j;
+    }
+    for (int v = 0; v < 1 + 2 * PIECE_CATALOG[shape].size; v++) {
+      h = (h ^ (uint32_t)values[v]) * 0x100000001b3ULL;
+    }
+  }
+  return h;
+}
+
+// Where a set of offsets sits in the catalog: they are the cells of
+// PIECE_CATALOG[shape].rotations[base_rotation], moved by `anchor`.
+struct CatalogMatch {
+  int shape;
+  int base_rotation;
+  ShapeCell anchor;
+};
+
+// Finds the catalog shape that, in some rotation and up to translation, has
+// exactly the given offsets. Returns a match with shape == NO_SHAPE if there
+// is none.
+inline CatalogMatch find_catalog_shape(const ShapeCell* offsets, int size) {
+  CatalogMatch match = {NO_SHAPE, 0, {0, 0}};
+  uint64_t key = size > 0 ? shape_key(offsets, size) : 0;
+  if (!key) {
+    return match;
+  }
+  int min_i = offsets[0].i;
+  int min_j = offsets[0].j;
+  for (int k = 1; k < size; k++) {
+    if (offsets[k].i < min_i) min_i = offsets[k].i;
+    if (offsets[k].j < min_j) min_j = offsets[k].j;
+  }
+  for (int shape = 0; shape < CATALOG_SIZE; shape++) {
+    if (PIECE_CATALOG[shape].size != size) {
+      continue;
+    }
+    for (int base_rotation = 0; base_rotation < 4; base_rotation++) {
+      const ShapeRotation& base = PIECE_CATALOG[shape].rotations[base_rotation];
+      if (base.key == key) {
+        match.shape = shape;
+        match.base_rotation = base_rotation;
+        match.anchor.i = min_i - base.min_i;
+        match.anchor.j = min_j - base.min_j;
+        return match;
+      }
+    }
+  }
+  return match;
+}
+
+// Builds the rotation tables for a block with the given offsets, so that
+// block rotation r occupies exactly the cells of table->rotations[r] around
+// the block's center. Catalog shapes are copied from PIECE_CATALOG and
+// shifted into place; other shapes are built from scratch. Returns the
+// catalog index of the shape, or NO_SHAPE if it isn't in the catalog.
+//
+// The offsets must satisfy shape_fits.
+inline int build_shape_table(const ShapeCell* offsets, int size, ShapeTable* table) {
+  CatalogMatch match = find_catalog_shape(offsets, size);
+  if (match.shape == NO_SHAPE) {
+    *table = make_shape(offsets, size);
+    return NO_SHAPE;
+  }
+  // Rotating the block r times gives catalog rotation base_rotation + r,
+  // moved by the anchor rotated r times.
+  table->size = size;
+  for (int rotation = 0; rotation < 4; rotation++) {
+    ShapeRotation& out = table->rotations[rotation];
+    out = PIECE_CATALOG[match.shape].rotations[(match.base_rotation + rotation) & 3];
+    ShapeCell shift = rotate_cell(match.anchor, rotation);
+    out.min_i += shift.i;
+    out.min_j += shift.j;
+    for (int k = 0; k < size; k++) {
+      out.cells[k].i += shift.i;
+      out.cells[k].j += shift.j;
+    }
+  }
+  return match.shape;
+}
+
+#endif  // PIECE_CATALOG_H_
@@ -0,0 +1,147 @@
+#ifndef REFERENCE_H_
+#define REFERENCE_H_
+
+#include "dropblox_ai.h"
+#include "engine.h"
+#include "evaluator.h"
+
+#include <string>
+#include <vector>
+
+// The engine's board operations written the plainest way: cell by cell from
+// a block's offsets, straight off the bitmap, with no shape tables, row
+// masks, batches or caches. They're slow, and they're the definition of
+// right: difftest checks every fast path in the engine against them.
+
+// Where square `k` of `block` is when the block is moved to `translation`
+// and `rotation`.
+inline Point reference_square(const Block& block, const Point& translation, int rotation, int k) {
+  Point point;
+  point.i = block.center.i + translation.i;
+  point.j = block.center.j + translation.j;
+  rotation &= 3;
+  if (rotation % 2) {
+    point.i += (2 - rotation) * block.offsets[k].j;
+    point.j += -(2 - rotation) * block.offsets[k].i;
+  } else {
+    point.i += (1 - rotation) * block.offsets[k].i;
+    point.j += (1 - rotation) * block.offsets[k].j;
+  }
+  return point;
+}
+
+template <int ROWS, int COLS>
+bool reference_check(const BasicBoard<ROWS, COLS>& board, const Block& block,
+                     const Point& translation, int rotation) {
+  for (int k = 0; k < block.size; k++) {
+    Point point = reference_square(block, translation, rotation, k);
+    if (point.i < 0 || point.i >= ROWS || point.j < 0 || point.j >= COLS ||
+        board.bitmap[point.i][point.j]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Removes every full row, moving the rows above it down one at a time, and
+// returns how many were removed.
+template <int ROWS, int COLS>
+int reference_remove_rows(int (*bitmap)[COLS]) {
+  int removed = 0;
+  int i = ROWS - 1;
+  while (i >= 0) {
+    bool full = true;
+    for (int j = 0; j < COLS; j++) {
+      full = full && bitmap[i][j];
+    }
+    if (!full) {
+      i--;
+      continue;
+    }
+    for (int above = i; above > 0; above--) {
+      for (int j = 0; j < COLS; j++) {
+        bitmap[above][j] = bitmap[above - 1][j];
+      }
+    }
+    for (int j = 0; j < COLS; j++) {
+      bitmap[0][j] = 0;
+    }
+    removed++;
+  }
+  return removed;
+}
+
+// Drops the board's block from `translation` and `rotation` into `result`'s
+// bitmap, and returns the rows removed. Only the bitmap of `result` is
+// written. The block must start in a valid position.
+template <int ROWS, int COLS>
+int reference_place(const BasicBoard<ROWS, COLS>& board, const Point& translation, int rotation,
+                    BasicBoard<ROWS, COLS>* result, Point* landing) {
+  const Block& block = *board.block;
+  Point drop = translation;
+  while (reference_check(board, block, Point{drop.i + 1, drop.j}, rotation)) {
+    drop.i++;
+  }
+  *landing = drop;
+  for (int i = 0; i < ROWS; i++) {
+    for (int j = 0; j < COLS; j++) {
+      result->bitmap[i][j] = board.bitmap[i][j];
+    }
+  }
+  for (int k = 0; k < block.size; k++) {
+    Point point = reference_square(block, drop, rotation, k);
+    result->bitmap[point.i][point.j] = 1;
+  }
+  return reference_remove_rows<ROWS, COLS>(result->bitmap);
+}
+
+// The placements pick_move considers, by the same sweep.
+template <int ROWS, int COLS>
+void reference_placements(const BasicBoard<ROWS, COLS>& board, vector<Placement>* placements) {
+  const Block& block = *board.block;
+  for (int rotation = 0; rotation < 4; rotation++) {
+    if (!reference_check(board, block, Point{0, 0}, rotation)) {
+      continue;
+    }
+    for (int j = -1; reference_check(board, block, Point{0, j}, rotation); j--) {
+      placements->push_back(Placement{rotation, j});
+    }
+    for (int j = 1; reference_check(board, block, Point{0, j}, rotation); j++) {
+      placements->push_back(Placement{rotation, j});
+    }
+  }
+}
+
+// The commands that make a placement.
+inline vector<string> reference_commands(const Placement& placement) {
+  vector<string> commands(placement.rotation, "rotate");
+  int steps = placement.translation < 0 ? -placement.translation : placement.translation;
+  commands.insert(commands.end(), steps, placement.translation < 0 ? "left" : "right");
+  return commands;
+}
+
+// Picks a move the way pick_move does, scoring each placement on its own
+// with the scalar feature functions. Ties go to the first placement.
+template <int ROWS, int COLS>
+vector<string> reference_pick_move(const BasicBoard<ROWS, COLS>& board,
+                                   const Weights& weights = SHIPPED_WEIGHTS) {
+  RuntimeEvaluator evaluator(weights);
+  vector<Placement> placements;
+  reference_placements(board, &placements);
+  BasicBoard<ROWS, COLS> result;
+  float best = -99999999;
+  vector<string> commands;
+  for (size_t p = 0; p < placements.size(); p++) {
+    Point landing;
+    int rows = reference_place(board, Point{0, placements[p].translation},
+                               placements[p].rotation, &result, &landing);
+    float score = evaluator.score(result, board.block->center.i + landing.i, rows);
+    if (score > best) {
+      best = score;
+      commands = reference_commands(placements[p]);
+    }
+  }
+  return commands;
+}
+
+#endif  // REFERENCE_H_
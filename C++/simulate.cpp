@@ -0,0 +1,122 @@
+// Plays games against the simulator in simulator.h, with the engine picking
+// every move in-process.
+//
+//   simulate [--games N] [--seed S] [--turns T] [--block-size K]
+//
+// plays N games (default 10) with seeds S, S+1, ... (default 1), each for at
+// most T turns (default no limit) with blocks of up to K squares, and prints
+// one line per game and a summary.
+//
+//   simulate --step [--seed S] [--block-size K]
+//
+// plays one game whose moves come from stdin instead: it writes the game
+// state as a line of JSON, in the format the server sends, then reads a line
+// of space-separated commands for the block, and so on until the game is
+// over. The state has a "score" and a "state" that is "playing" or "failed".
+
+#include "dropblox_ai.h"
+#include "simulator.h"
+#include "state_json.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <sys/time.h>
+
+using namespace std;
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void usage(const char* name) {
+  cerr << "Usage: " << name << " [--games N] [--seed S] [--turns T] [--block-size K]" << endl;
+  cerr << "       " << name << " --step [--seed S] [--block-size K]" << endl;
+  exit(1);
+}
+
+// Plays one game with moves read from stdin.
+static void step_game(uint64_t seed, int block_size) {
+  Simulator<DEFAULT_ROWS, DEFAULT_COLS> simulator(seed, block_size);
+  GameState state;
+  string line;
+  while (true) {
+    simulator.get_state(&state);
+    ostringstream extra;
+    extra << ", \"score\": " << simulator.get_result().score << ", \"state\": \""
+          << (simulator.game_over() ? "failed" : "playing") << "\"";
+    write_json_state(state, cout, extra.str());
+    if (simulator.game_over() || !getline(cin, line)) {
+      break;
+    }
+    istringstream words(line);
+    vector<string> commands;
+    string command;
+    while (words >> command) {
+      commands.push_back(command);
+    }
+    simulator.step(commands);
+  }
+}
+
+int main(int argc, char** argv) {
+  int games = 10;
+  uint64_t seed = 1;
+  int max_turns = 0;
+  int block_size = SIMULATED_BLOCK_SIZE;
+  bool step = false;
+  for (int k = 1; k < argc; k++) {
+    if (strcmp(argv[k], "--step") == 0) {
+      step = true;
+      continue;
+    }
+    if (k + 1 == argc) {
+      usage(argv[0]);
+    }
+    if (strcmp(argv[k], "--games") == 0) {
+      games = atoi(argv[++k]);
+    } else if (strcmp(argv[k], "--seed") == 0) {
+      seed = strtoull(argv[++k], NULL, 10);
+    } else if (strcmp(argv[k], "--turns") == 0) {
+      max_turns = atoi(argv[++k]);
+    } else if (strcmp(argv[k], "--block-size") == 0) {
+      block_size = atoi(argv[++k]);
+    } else {
+      usage(argv[0]);
+    }
+  }
+
+  if (step) {
+    step_game(seed, block_size);
+    return 0;
+  }
+
+  engine_debug = false;
+  long total_score = 0;
+  long total_lines = 0;
+  long total_turns = 0;
+  double start = now();
+  for (int game = 0; game < games; game++) {
+    GameResult result =
+        play_game<DEFAULT_ROWS, DEFAULT_COLS>(seed + game, max_turns, block_size);
+    printf("seed %llu: score %d, lines %d, turns %d\n", (unsigned long long)result.seed,
+           result.score, result.lines, result.turns);
+    if (result.illegal_commands) {
+      printf("  %d illegal commands skipped\n", result.illegal_commands);
+    }
+    total_score += result.score;
+    total_lines += result.lines;
+    total_turns += result.turns;
+  }
+  double elapsed = now() - start;
+  if (games > 0) {
+    printf("%d games: mean score %.1f, mean lines %.1f, mean turns %.1f, %.0f turns/s\n",
+           games, (double)total_score / games, (double)total_lines / games,
+           (double)total_turns / games, elapsed > 0 ? total_turns / elapsed : 0.0);
+  }
+  return 0;
+}
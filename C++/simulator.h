@@ -0,0 +1,248 @@
+#ifndef SIMULATOR_H_
+#define SIMULATOR_H_
+
+#include "engine.h"
+#include "evaluator.h"
+#include "state_json.h"
+
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// A headless stand-in for the game server, so the engine can play whole games
+// in-process. Blocks are drawn from PIECE_CATALOG by a seeded generator, so a
+// seed always produces the same sequence of blocks, and a game is scored the
+// way the server scores it: points_earned(rows) for every block dropped.
+//
+// The simulator keeps the board as a BasicBoard and uses the engine's own
+// check, place_into and remove_rows, so it plays by exactly the rules the
+// engine assumes.
+
+// The largest blocks the simulator draws by default: the whole catalog.
+#define SIMULATED_BLOCK_SIZE 5
+
+// A small, fast generator whose output depends only on its seed (splitmix64),
+// so games replay identically everywhere.
+class SimRandom {
+ public:
+  explicit SimRandom(uint64_t seed) : state(seed) {}
+
+  uint64_t next() {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  // A number in [0, n).
+  int below(int n) {
+    return (int)(((next() >> 32) * (uint64_t)n) >> 32);
+  }
+
+ private:
+  uint64_t state;
+};
+
+// How a game went.
+struct GameResult {
+  uint64_t seed;
+  int score;
+  int lines;
+  int turns;
+  // Commands that would have moved a block into an invalid position, and
+  // were skipped.
+  int illegal_commands;
+};
+
+// Builds a catalog shape in its spawn position on a board COLS wide:
+// unrotated, centered and touching the top, turning about its middle square.
+template <int COLS>
+Block* spawn_block(int shape) {
+  const ShapeRotation& base = PIECE_CATALOG[shape].rotations[0];
+  Point pivot = {(base.height - 1) / 2, (base.width - 1) / 2};
+  vector<Point> offsets(PIECE_CATALOG[shape].size);
+  for (size_t k = 0; k < offsets.size(); k++) {
+    offsets[k].i = base.cells[k].i - base.min_i - pivot.i;
+    offsets[k].j = base.cells[k].j - base.min_j - pivot.j;
+  }
+  Point center = {pivot.i, (COLS - base.width) / 2 + pivot.j};
+  return new Block(center, offsets);
+}
+
+template <int ROWS, int COLS>
+class Simulator {
+ public:
+  // Starts a game with blocks of up to `max_block_size` squares.
+  explicit Simulator(uint64_t seed, int max_block_size = SIMULATED_BLOCK_SIZE)
+      : rng(seed), over(false) {
+    result.seed = seed;
+    result.score = 0;
+    result.lines = 0;
+    result.turns = 0;
+    result.illegal_commands = 0;
+    for (int shape = 0; shape < CATALOG_SIZE; shape++) {
+      if (PIECE_CATALOG[shape].size <= max_block_size) {
+        shapes.push_back(spawn_block<COLS>(shape));
+      }
+    }
+    if (shapes.empty()) {
+      throw Exception("No blocks small enough to simulate");
+    }
+    for (int k = 0; k <= PREVIEW_SIZE; k++) {
+      upcoming.push_back(draw());
+    }
+    uint64_t empty[ROWS] = {0};
+    boards[0] = new BasicBoard<ROWS, COLS>(empty, NULL, Preview());
+    boards[1] = new BasicBoard<ROWS, COLS>();
+    current = 0;
+    deal();
+  }
+
+  ~Simulator() {
+    delete boards[0];
+    delete boards[1];
+    for (size_t k = 0; k < shapes.size(); k++) {
+      delete shapes[k];
+    }
+  }
+
+  // The board as the engine sees it: the block to place, and the preview.
+  const BasicBoard<ROWS, COLS>& board() const { return *boards[current]; }
+
+  bool game_over() const { return over; }
+  const GameResult& get_result() const { return result; }
+
+  // Moves the current block by `commands`, each one of "left", "right", "up",
+  // "down" or "rotate", then drops it and deals the next block. Commands that
+  // would move the block into an invalid position are skipped, and counted.
+  // Returns false once the game is over.
+  bool step(const vector<string>& commands) {
+    if (over) {
+      return false;
+    }
+    BasicBoard<ROWS, COLS>& board = *boards[current];
+    Block* block = board.block;
+    block->reset_position();
+    for (size_t k = 0; k < commands.size(); k++) {
+      if (commands[k] == "drop") {
+        break;
+      }
+      Point translation = block->translation;
+      int rotation = block->rotation;
+      block->do_command(commands[k]);
+      if (!board.check(*block)) {
+        block->translation = translation;
+        block->rotation = rotation;
+        result.illegal_commands++;
+      }
+    }
+
+    Point landing;
+    int rows = board.place_into(*block, block->translation, block->rotation,
+                                boards[1 - current], &landing);
+    block->reset_position();
+    current = 1 - current;
+    result.score += points_earned(rows);
+    result.lines += rows;
+    result.turns++;
+
+    upcoming.erase(upcoming.begin());
+    upcoming.push_back(draw());
+    deal();
+    return !over;
+  }
+
+  // Copies the state the server would send into `state`. The blocks still
+  // belong to the simulator.
+  void get_state(GameState* state) const {
+    const BasicBoard<ROWS, COLS>& board = *boards[current];
+    state->rows = ROWS;
+    state->cols = COLS;
+    for (int i = 0; i < ROWS; i++) {
+      state->row_masks[i] = board.row_masks[i];
+    }
+    state->block = upcoming[0];
+    state->preview.assign(upcoming.begin() + 1, upcoming.end());
+  }
+
+ private:
+  SimRandom rng;
+  // One block per shape in play, shared by every turn that deals that shape.
+  vector<Block*> shapes;
+  // The block to place, followed by the preview.
+  vector<Block*> upcoming;
+  // The board and the one the block lands on, swapped every turn.
+  BasicBoard<ROWS, COLS>* boards[2];
+  int current;
+  bool over;
+  GameResult result;
+
+  Simulator(const Simulator&);
+  Simulator& operator=(const Simulator&);
+
+  Block* draw() {
+    return shapes[rng.below((int)shapes.size())];
+  }
+
+  // Points the board at the current block and preview, and ends the game if
+  // the block has nowhere to go.
+  void deal() {
+    BasicBoard<ROWS, COLS>& board = *boards[current];
+    board.block = upcoming[0];
+    board.preview = Preview(&upcoming, 1);
+    if (!board.check(*board.block)) {
+      over = true;
+    }
+  }
+};
+
+// Plays a game with the engine, for at most `max_turns` turns (0 for no
+// limit), scoring placements with `weights`, and returns how it went. If
+// `move_seconds` is given, how long the engine took to pick each move is
+// appended to it.
+template <int ROWS, int COLS>
+GameResult play_game(uint64_t seed, int max_turns, int max_block_size,
+                     vector<double>* move_seconds = NULL,
+                     const Weights& weights = SHIPPED_WEIGHTS) {
+  typedef std::chrono::steady_clock Clock;
+  Simulator<ROWS, COLS> simulator(seed, max_block_size);
+  MoveScratch<ROWS, COLS> scratch;
+  while (!simulator.game_over() &&
+         (max_turns <= 0 || simulator.get_result().turns < max_turns)) {
+    Clock::time_point start = Clock::now();
+    vector<string> moves = pick_move(simulator.board(), &scratch, weights);
+    if (move_seconds) {
+      move_seconds->push_back(std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    simulator.step(moves);
+  }
+  return simulator.get_result();
+}
+
+// Plays `games` games with the engine, from seeds seed, seed + 1, ..., and
+// appends the state every `every` turns to `states`, as a line of JSON. Each
+// game is cut off after `max_turns` turns (0 for no limit). The states are
+// the kind of boards the engine sees in a real game.
+template <int ROWS, int COLS>
+void record_states(uint64_t seed, int games, int every, int max_turns, int max_block_size,
+                   vector<string>* states) {
+  MoveScratch<ROWS, COLS> scratch;
+  for (int game = 0; game < games; game++) {
+    Simulator<ROWS, COLS> simulator(seed + game, max_block_size);
+    while (!simulator.game_over() &&
+           (max_turns <= 0 || simulator.get_result().turns < max_turns)) {
+      int turn = simulator.get_result().turns;
+      if (turn > 0 && turn % every == 0) {
+        GameState state;
+        simulator.get_state(&state);
+        ostringstream json;
+        write_json_state(state, json);
+        states->push_back(json.str());
+      }
+      simulator.step(pick_move(simulator.board(), &scratch));
+    }
+  }
+}
+
+#endif  // SIMULATOR_H_
@@ -0,0 +1,155 @@
+#ifndef STAGED_EVALUATOR_H_
+#define STAGED_EVALUATOR_H_
+
+#include "batch_evaluator.h"
+
+#include <cstddef>
+
+// Picks the best few of many candidate boards without scoring all of them in
+// full. The cheap features are worked out first. Every feature still to come
+// is then bounded by its range on this geometry and the sign of its weight.
+// If even the best score those bounds allow can't get into the top k, the
+// board is dropped before its expensive features are computed.
+//
+// The bound is summed in the same order and precision as the real score, and
+// rounding is monotonic, so a board is only dropped if its real score
+// couldn't have made the cut. The top k come out exactly as they would by
+// scoring every board with evaluate_batch.
+
+inline int mask_popcount(uint64_t mask) {
+  return __builtin_popcountll(mask);
+}
+
+// The same features as in evaluator.h, worked out from one board's row masks.
+template <int ROWS, int COLS>
+int count_holes(const BasicPackedBoard<ROWS, COLS>& board) {
+  int holes = 0;
+  for (int i = 0; i < ROWS; i++) {
+    if (board.row_masks[i]) {
+      holes += COLS - mask_popcount(board.row_masks[i]);
+    }
+  }
+  return holes;
+}
+
+template <int ROWS, int COLS>
+int count_row_transitions(const BasicPackedBoard<ROWS, COLS>& board) {
+  // Each square against its left neighbour, with both walls filled.
+  const uint64_t RIGHT_WALL = (uint64_t)1 << COLS;
+  int transitions = 0;
+  for (int i = 0; i < ROWS; i++) {
+    uint64_t row = board.row_masks[i];
+    transitions += mask_popcount(((row << 1) | 1) ^ (row | RIGHT_WALL));
+  }
+  return transitions;
+}
+
+template <int ROWS, int COLS>
+int count_col_transitions(const BasicPackedBoard<ROWS, COLS>& board) {
+  // Each row against the one above, with the ceiling and floor filled.
+  const uint64_t FULL = ~(uint64_t)0 >> (64 - COLS);
+  int transitions = 0;
+  uint64_t above = FULL;
+  for (int i = 0; i < ROWS; i++) {
+    transitions += mask_popcount(above ^ board.row_masks[i]);
+    above = board.row_masks[i];
+  }
+  return transitions + mask_popcount(~above & FULL);
+}
+
+template <int ROWS, int COLS>
+int count_well_sum(const BasicPackedBoard<ROWS, COLS>& board) {
+  const uint64_t FULL = ~(uint64_t)0 >> (64 - COLS);
+  const uint64_t LAST_COL = (uint64_t)1 << (COLS - 1);
+  int well_sum = 0;
+  uint64_t roof = 0;
+  uint64_t wells = 0;
+  for (int i = 0; i < ROWS; i++) {
+    uint64_t row = board.row_masks[i];
+    roof |= row;
+    wells |= ~roof & ((row << 1) | 1) & ((row >> 1) | LAST_COL) & FULL;
+    well_sum += mask_popcount(wells & ~row & FULL);
+  }
+  return well_sum;
+}
+
+template <int ROWS, int COLS>
+class StagedEvaluator {
+ public:
+  explicit StagedEvaluator(const Weights& weights = SHIPPED_WEIGHTS)
+      : weights(weights), full_scores(0) {
+    // Column transitions: at most one per row boundary, ceiling and floor
+    // included, in every column. Well sums: at most every square.
+    col_transitions_bound = bound(COL_TRANSITIONS, 0, COLS * (ROWS + 1));
+    well_sums_bound = bound(WELL_SUMS, 0, ROWS * COLS);
+  }
+
+  // Writes the indices of the (at most) k best of the n boards to best[] and
+  // their scores to scores[], best first, and returns how many there are.
+  // Boards with equal scores keep their order, so with k = 1 this picks the
+  // first board with the highest score.
+  int top_k(const BasicPackedBoard<ROWS, COLS>* boards, size_t n, int k, int* best,
+            float* scores) {
+    int count = 0;
+    if (k <= 0) {
+      return 0;
+    }
+    for (size_t b = 0; b < n; b++) {
+      const BasicPackedBoard<ROWS, COLS>& board = boards[b];
+      bool full = count == k;
+      float threshold = full ? scores[k - 1] : 0;
+
+      int rows_removed = board.rows_removed;
+      double points = points_earned(rows_removed) * w(POINTS_EARNED);
+      double cheap = 0;
+      cheap += rows_removed * w(ROWS_REMOVED);
+      cheap += board.landing_height * w(LANDING_HEIGHT);
+      cheap += count_holes(board) * w(HOLES);
+      cheap += count_row_transitions(board) * w(ROW_TRANSITIONS);
+      if (full && (float)(cheap + col_transitions_bound + well_sums_bound + points) <= threshold) {
+        continue;
+      }
+
+      double partial = cheap + count_col_transitions(board) * w(COL_TRANSITIONS);
+      if (full && (float)(partial + well_sums_bound + points) <= threshold) {
+        continue;
+      }
+
+      float score = partial + count_well_sum(board) * w(WELL_SUMS) + points;
+      full_scores++;
+      if (full && score <= threshold) {
+        continue;
+      }
+      // Insert after every kept board that scores at least as well.
+      int slot = full ? k - 1 : count++;
+      while (slot > 0 && scores[slot - 1] < score) {
+        scores[slot] = scores[slot - 1];
+        best[slot] = best[slot - 1];
+        slot--;
+      }
+      scores[slot] = score;
+      best[slot] = (int)b;
+    }
+    return count;
+  }
+
+  // How many boards were scored in full, over all calls.
+  size_t get_full_scores() const { return full_scores; }
+
+ private:
+  Weights weights;
+  double col_transitions_bound;
+  double well_sums_bound;
+  size_t full_scores;
+
+  double w(Feature feature) const { return weights.weights[feature]; }
+
+  // The most a feature with values in [low, high] can add to a score.
+  double bound(Feature feature, int low, int high) const {
+    double a = low * w(feature);
+    double b = high * w(feature);
+    return a > b ? a : b;
+  }
+};
+
+#endif  // STAGED_EVALUATOR_H_
@@ -0,0 +1,218 @@
+#ifndef STATE_BINARY_H_
+#define STATE_BINARY_H_
+
+#include "dropblox_ai.h"
+
+#include <cstring>
+#include <string>
+
+// A compact binary encoding of a GameState, for replay logs, fixtures and
+// anything else that stores or ships a lot of states. A 33x12 state with five
+// preview blocks takes about a hundred bytes instead of a few kilobytes of
+// JSON. All multi-byte fields are little-endian:
+//
+//   4 bytes  magic, "DBXS"
+//   1 byte   format version, BINARY_STATE_VERSION
+//   1 byte   rows
+//   1 byte   cols
+//   1 byte   number of preview blocks
+//   rows * ceil(cols / 8) bytes
+//            the bitmap, one mask per row, with column j in bit j
+//   the block, then each preview block:
+//     2 bytes  center i, center j (signed)
+//     1 byte   index into PIECE_CATALOG, or BINARY_CUSTOM_SHAPE
+//     catalog shapes: 1 byte base rotation, 2 bytes anchor i, j (signed)
+//     other shapes:   1 byte cell count, then i, j (signed) for each cell
+//
+// Catalog shapes are decoded to the catalog's offsets for that rotation and
+// anchor, which cover the same squares as the originals but may list them in
+// a different order.
+
+#define BINARY_STATE_MAGIC "DBXS"
+// Bump this whenever the layout above or PIECE_CATALOG changes: files store
+// catalog indices, so a file written against another catalog would decode
+// to the wrong shapes. Readers reject every other version.
+#define BINARY_STATE_VERSION 1
+#define BINARY_CUSTOM_SHAPE 0xff
+
+// catalog_hash() of the PIECE_CATALOG that BINARY_STATE_VERSION's files
+// were written against. When the catalog changes, bump the version and
+// set this to the new hash.
+#define BINARY_CATALOG_HASH 0x1c25a49ae4689c65ULL
+static_assert(catalog_hash() == BINARY_CATALOG_HASH,
+              "PIECE_CATALOG changed: bump BINARY_STATE_VERSION and update BINARY_CATALOG_HASH");
+
+inline bool is_binary_state(const char* begin, const char* end) {
+  return end - begin >= 4 && memcmp(begin, BINARY_STATE_MAGIC, 4) == 0;
+}
+
+class BinaryStateWriter {
+ public:
+  explicit BinaryStateWriter(string* out) : out(out) {}
+
+  void write(const GameState& state) {
+    if (state.rows > 255 || state.cols > 64 || state.preview.size() > 255) {
+      throw Exception("Game state is too large for the binary format");
+    }
+    out->append(BINARY_STATE_MAGIC, 4);
+    put(BINARY_STATE_VERSION);
+    put(state.rows);
+    put(state.cols);
+    put(state.preview.size());
+    int row_bytes = (state.cols + 7) / 8;
+    for (int i = 0; i < state.rows; i++) {
+      for (int b = 0; b < row_bytes; b++) {
+        put((state.row_masks[i] >> (8 * b)) & 0xff);
+      }
+    }
+    write_block(*state.block);
+    for (size_t k = 0; k < state.preview.size(); k++) {
+      write_block(*state.preview[k]);
+    }
+  }
+
+ private:
+  string* out;
+
+  void put(int byte) {
+    out->push_back((char)byte);
+  }
+
+  void put_signed(int value) {
+    if (value < -128 || value > 127) {
+      throw Exception("Block coordinate out of range for the binary format");
+    }
+    put(value & 0xff);
+  }
+
+  void write_block(const Block& block) {
+    put_signed(block.center.i);
+    put_signed(block.center.j);
+    vector<ShapeCell> cells(block.size);
+    for (int k = 0; k < block.size; k++) {
+      cells[k].i = block.offsets[k].i;
+      cells[k].j = block.offsets[k].j;
+    }
+    CatalogMatch match = find_catalog_shape(cells.data(), block.size);
+    if (match.shape != NO_SHAPE) {
+      put(match.shape);
+      put(match.base_rotation);
+      put_signed(match.anchor.i);
+      put_signed(match.anchor.j);
+      return;
+    }
+    if (block.size > 255) {
+      throw Exception("Block is too large for the binary format");
+    }
+    put(BINARY_CUSTOM_SHAPE);
+    put(block.size);
+    for (int k = 0; k < block.size; k++) {
+      put_signed(block.offsets[k].i);
+      put_signed(block.offsets[k].j);
+    }
+  }
+};
+
+class BinaryStateReader {
+ public:
+  BinaryStateReader(const char* begin, const char* end)
+      : pos((const unsigned char*)begin), end((const unsigned char*)end) {}
+
+  void read(GameState* state) {
+    if (!is_binary_state((const char*)pos, (const char*)end)) {
+      fail("Not a binary game state");
+    }
+    pos += 4;
+    if (get() != BINARY_STATE_VERSION) {
+      fail("Unsupported binary game state version");
+    }
+    state->rows = get();
+    state->cols = get();
+    int preview_size = get();
+    if (state->rows > MAX_STATE_ROWS || state->cols > 64) {
+      fail("Binary game state is too large");
+    }
+    int row_bytes = (state->cols + 7) / 8;
+    for (int i = 0; i < state->rows; i++) {
+      uint64_t mask = 0;
+      for (int b = 0; b < row_bytes; b++) {
+        mask |= (uint64_t)get() << (8 * b);
+      }
+      state->row_masks[i] = mask;
+    }
+    state->block = read_block();
+    for (int k = 0; k < preview_size; k++) {
+      state->preview.push_back(read_block());
+    }
+    if (pos != end) {
+      fail("Trailing bytes after binary game state");
+    }
+  }
+
+ private:
+  const unsigned char* pos;
+  const unsigned char* end;
+
+  void fail(const string& message) {
+    throw Exception(message);
+  }
+
+  int get() {
+    if (pos >= end) {
+      fail("Truncated binary game state");
+    }
+    return *pos++;
+  }
+
+  int get_signed() {
+    return (signed char)get();
+  }
+
+  Block* read_block() {
+    Point center;
+    center.i = get_signed();
+    center.j = get_signed();
+    vector<Point> offsets;
+    int shape = get();
+    if (shape == BINARY_CUSTOM_SHAPE) {
+      int size = get();
+      offsets.resize(size);
+      for (int k = 0; k < size; k++) {
+        offsets[k].i = get_signed();
+        offsets[k].j = get_signed();
+      }
+    } else {
+      if (shape >= CATALOG_SIZE) {
+        fail("Unknown shape in binary game state");
+      }
+      int rotation = get();
+      if (rotation > 3) {
+        fail("Invalid rotation in binary game state");
+      }
+      const ShapeRotation& base = PIECE_CATALOG[shape].rotations[rotation];
+      int anchor_i = get_signed();
+      int anchor_j = get_signed();
+      offsets.resize(PIECE_CATALOG[shape].size);
+      for (size_t k = 0; k < offsets.size(); k++) {
+        offsets[k].i = base.cells[k].i + anchor_i;
+        offsets[k].j = base.cells[k].j + anchor_j;
+      }
+    }
+    if (offsets.empty()) {
+      fail("Block without offsets in binary game state");
+    }
+    return new Block(center, offsets);
+  }
+};
+
+// Appends the binary encoding of `state` to `out`.
+inline void write_binary_state(const GameState& state, string* out) {
+  BinaryStateWriter(out).write(state);
+}
+
+// Decodes the binary game state in [begin, end) into `state`.
+inline void parse_binary_state(const char* begin, const char* end, GameState* state) {
+  BinaryStateReader(begin, end).read(state);
+}
+
+#endif  // STATE_BINARY_H_
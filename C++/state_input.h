@@ -0,0 +1,117 @@
+#ifndef STATE_INPUT_H_
+#define STATE_INPUT_H_
+
+#include "json/elements.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Where the game state comes from, as named by a command-line argument:
+//
+//   -       read the state from stdin
+//   @path   read the state from a file, memory-mapping it when possible
+//   other   the argument is the state itself
+//
+// In every case the parser runs directly over the resulting buffer, so the
+// state is never copied after it has been read.
+class StateInput {
+ public:
+  explicit StateInput(const char* arg) : mapping(NULL), mapped_size(0) {
+    if (strcmp(arg, "-") == 0) {
+      read_all(STDIN_FILENO, "stdin");
+      set_buffer();
+    } else if (arg[0] == '@') {
+      read_file(arg + 1);
+    } else {
+      data = arg;
+      size = strlen(arg);
+    }
+  }
+
+  ~StateInput() {
+    if (mapping) {
+      munmap(mapping, mapped_size);
+    }
+  }
+
+  const char* begin() const { return data; }
+  const char* end() const { return data + size; }
+
+ private:
+  std::string buffer;
+  void* mapping;
+  size_t mapped_size;
+  const char* data;
+  size_t size;
+
+  StateInput(const StateInput&);
+  StateInput& operator=(const StateInput&);
+
+  static void fail(const std::string& what, const char* name) {
+    throw json::Exception(what + " " + name + ": " + strerror(errno));
+  }
+
+  // Closes a file descriptor when it goes out of scope, so it isn't leaked
+  // when reading it throws.
+  class FileCloser {
+   public:
+    explicit FileCloser(int fd) : fd(fd) {}
+    ~FileCloser() { close(fd); }
+
+   private:
+    int fd;
+
+    FileCloser(const FileCloser&);
+    FileCloser& operator=(const FileCloser&);
+  };
+
+  void set_buffer() {
+    data = buffer.data();
+    size = buffer.size();
+  }
+
+  void read_all(int fd, const char* name) {
+    char chunk[1 << 16];
+    ssize_t n;
+    while ((n = read(fd, chunk, sizeof(chunk))) != 0) {
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        fail("Could not read", name);
+      }
+      buffer.append(chunk, n);
+    }
+  }
+
+  void read_file(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+      fail("Could not open", path);
+    }
+    FileCloser closer(fd);
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+      void* mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped != MAP_FAILED) {
+        mapping = mapped;
+        mapped_size = info.st_size;
+        data = (const char*)mapped;
+        size = mapped_size;
+        return;
+      }
+    }
+    // Pipes, empty files and anything else mmap won't take.
+    read_all(fd, path);
+    set_buffer();
+  }
+};
+
+#endif  // STATE_INPUT_H_
@@ -0,0 +1,43 @@
+#ifndef STATE_JSON_H_
+#define STATE_JSON_H_
+
+#include "dropblox_ai.h"
+
+#include <ostream>
+
+// Writes game states in the JSON format the server sends, for the tools that
+// produce states: the converter, and the simulator's step mode.
+
+inline void write_json_block(const Block& block, ostream& out) {
+  out << "{\"center\": {\"i\": " << block.center.i << ", \"j\": " << block.center.j
+      << "}, \"offsets\": [";
+  for (int k = 0; k < block.size; k++) {
+    out << (k ? ", " : "") << "{\"i\": " << block.offsets[k].i
+        << ", \"j\": " << block.offsets[k].j << "}";
+  }
+  out << "]}";
+}
+
+// Writes `state` as a JSON object on one line. `extra_members`, if given, is
+// written just before the closing brace, and should start with a comma.
+inline void write_json_state(const GameState& state, ostream& out,
+                             const string& extra_members = "") {
+  out << "{\"bitmap\": [";
+  for (int i = 0; i < state.rows; i++) {
+    out << (i ? ", " : "") << "[";
+    for (int j = 0; j < state.cols; j++) {
+      out << (j ? ", " : "") << ((state.row_masks[i] >> j) & 1);
+    }
+    out << "]";
+  }
+  out << "], \"block\": ";
+  write_json_block(*state.block, out);
+  out << ", \"preview\": [";
+  for (size_t k = 0; k < state.preview.size(); k++) {
+    out << (k ? ", " : "");
+    write_json_block(*state.preview[k], out);
+  }
+  out << "]" << extra_members << "}" << endl;
+}
+
+#endif  // STATE_JSON_H_
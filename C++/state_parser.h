@@ -0,0 +1,319 @@
+#ifndef STATE_PARSER_H_
+#define STATE_PARSER_H_
+
+#include "dropblox_ai.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <string>
+
+// A single-pass parser for the game state the client hands us. It reads the
+// bitmap, block and preview straight out of the input buffer into a
+// GameState, skipping every other field, without building a json::Object
+// along the way. Malformed input throws a json::Exception.
+class StateParser {
+ public:
+  StateParser(const char* begin, const char* end) : pos(begin), end(end) {}
+
+  void parse(GameState* state) {
+    bool has_bitmap = false;
+    expect('{');
+    if (!consume('}')) {
+      do {
+        const char* key;
+        int length;
+        parse_key(&key, &length);
+        expect(':');
+        if (key_is(key, length, "bitmap")) {
+          parse_bitmap(state);
+          has_bitmap = true;
+        } else if (key_is(key, length, "block")) {
+          state->block = parse_block();
+        } else if (key_is(key, length, "preview")) {
+          parse_preview(state);
+        } else {
+          skip_value();
+        }
+      } while (consume(','));
+      expect('}');
+    }
+    skip_whitespace();
+    if (pos != end) {
+      fail("Expected end of game state");
+    }
+    if (!has_bitmap || !state->block) {
+      fail("Game state is missing its bitmap or block");
+    }
+  }
+
+ private:
+  const char* pos;
+  const char* end;
+
+  void fail(const string& message) {
+    throw Exception(message);
+  }
+
+  void skip_whitespace() {
+    while (pos < end && (*pos == ' ' || *pos == '\n' || *pos == '\r' || *pos == '\t')) {
+      pos++;
+    }
+  }
+
+  // Skips whitespace, then consumes `c` if it's the next character.
+  bool consume(char c) {
+    skip_whitespace();
+    if (pos < end && *pos == c) {
+      pos++;
+      return true;
+    }
+    return false;
+  }
+
+  void expect(char c) {
+    if (!consume(c)) {
+      fail(string("Expected '") + c + "' in game state");
+    }
+  }
+
+  static bool key_is(const char* key, int length, const char* name) {
+    return (int)strlen(name) == length && memcmp(key, name, length) == 0;
+  }
+
+  // Points `key` at the raw characters of the next string. Escapes are left
+  // as they are, so keys containing them never match a field we read.
+  void parse_key(const char** key, int* length) {
+    expect('"');
+    *key = pos;
+    skip_string_body();
+    *length = (int)(pos - 1 - *key);
+  }
+
+  // Skips to just past the closing quote of a string whose opening quote has
+  // already been consumed.
+  void skip_string_body() {
+    while (pos < end && *pos != '"') {
+      if (*pos == '\\') {
+        pos++;
+      }
+      pos++;
+    }
+    if (pos >= end) {
+      fail("Unterminated string in game state");
+    }
+    pos++;
+  }
+
+  double parse_number() {
+    skip_whitespace();
+    bool negative = false;
+    if (pos < end && *pos == '-') {
+      negative = true;
+      pos++;
+    }
+    if (pos >= end || *pos < '0' || *pos > '9') {
+      fail("Expected a number in game state");
+    }
+    double value = 0;
+    while (pos < end && *pos >= '0' && *pos <= '9') {
+      value = 10 * value + (*pos++ - '0');
+    }
+    if (pos < end && *pos == '.') {
+      pos++;
+      double scale = 0.1;
+      while (pos < end && *pos >= '0' && *pos <= '9') {
+        value += scale * (*pos++ - '0');
+        scale /= 10;
+      }
+    }
+    if (pos < end && (*pos == 'e' || *pos == 'E')) {
+      pos++;
+      bool negative_exponent = false;
+      if (pos < end && (*pos == '+' || *pos == '-')) {
+        negative_exponent = (*pos++ == '-');
+      }
+      // Saturates: past 1000, every nonzero double has already overflowed
+      // or underflowed, and the int (and the loop below) stay bounded.
+      int exponent = 0;
+      while (pos < end && *pos >= '0' && *pos <= '9') {
+        exponent = min(10 * exponent + (*pos++ - '0'), 1000);
+      }
+      for (int k = 0; k < exponent; k++) {
+        value = negative_exponent ? value / 10 : value * 10;
+      }
+    }
+    return negative ? -value : value;
+  }
+
+  int parse_int() {
+    double value = parse_number();
+    if (!(value > INT_MIN - 1.0 && value < INT_MAX + 1.0)) {
+      fail("Number out of range in game state");
+    }
+    return (int)value;
+  }
+
+  void skip_literal(const char* literal) {
+    int length = strlen(literal);
+    if (end - pos < length || memcmp(pos, literal, length) != 0) {
+      fail(string("Expected ") + literal + " in game state");
+    }
+    pos += length;
+  }
+
+  void skip_value() {
+    skip_whitespace();
+    if (pos >= end) {
+      fail("Unexpected end of game state");
+    }
+    switch (*pos) {
+      case '{':
+        pos++;
+        if (!consume('}')) {
+          do {
+            expect('"');
+            skip_string_body();
+            expect(':');
+            skip_value();
+          } while (consume(','));
+          expect('}');
+        }
+        break;
+      case '[':
+        pos++;
+        if (!consume(']')) {
+          do {
+            skip_value();
+          } while (consume(','));
+          expect(']');
+        }
+        break;
+      case '"':
+        pos++;
+        skip_string_body();
+        break;
+      case 't':
+        skip_literal("true");
+        break;
+      case 'f':
+        skip_literal("false");
+        break;
+      case 'n':
+        skip_literal("null");
+        break;
+      default:
+        parse_number();
+    }
+  }
+
+  void parse_bitmap(GameState* state) {
+    state->rows = 0;
+    state->cols = 0;
+    expect('[');
+    if (consume(']')) {
+      return;
+    }
+    do {
+      if (state->rows == MAX_STATE_ROWS) {
+        fail("Too many rows in game state");
+      }
+      uint64_t mask = 0;
+      int cols = 0;
+      expect('[');
+      if (!consume(']')) {
+        do {
+          if (cols == 64) {
+            fail("Too many columns in game state");
+          }
+          if (parse_int()) {
+            mask |= (uint64_t)1 << cols;
+          }
+          cols++;
+        } while (consume(','));
+        expect(']');
+      }
+      if (state->rows && cols != state->cols) {
+        fail("Ragged bitmap in game state");
+      }
+      state->cols = cols;
+      state->row_masks[state->rows++] = mask;
+    } while (consume(','));
+    expect(']');
+  }
+
+  void parse_point(Point* point) {
+    point->i = 0;
+    point->j = 0;
+    expect('{');
+    if (consume('}')) {
+      return;
+    }
+    do {
+      const char* key;
+      int length;
+      parse_key(&key, &length);
+      expect(':');
+      if (key_is(key, length, "i")) {
+        point->i = parse_int();
+      } else if (key_is(key, length, "j")) {
+        point->j = parse_int();
+      } else {
+        skip_value();
+      }
+    } while (consume(','));
+    expect('}');
+  }
+
+  Block* parse_block() {
+    Point center = {0, 0};
+    vector<Point> offsets;
+    expect('{');
+    if (!consume('}')) {
+      do {
+        const char* key;
+        int length;
+        parse_key(&key, &length);
+        expect(':');
+        if (key_is(key, length, "center")) {
+          parse_point(&center);
+        } else if (key_is(key, length, "offsets")) {
+          expect('[');
+          if (!consume(']')) {
+            do {
+              Point offset;
+              parse_point(&offset);
+              offsets.push_back(offset);
+            } while (consume(','));
+            expect(']');
+          }
+        } else {
+          skip_value();
+        }
+      } while (consume(','));
+      expect('}');
+    }
+    if (offsets.empty()) {
+      fail("Block without offsets in game state");
+    }
+    return new Block(center, offsets);
+  }
+
+  void parse_preview(GameState* state) {
+    expect('[');
+    if (consume(']')) {
+      return;
+    }
+    do {
+      state->preview.push_back(parse_block());
+    } while (consume(','));
+    expect(']');
+  }
+};
+
+// Parses the game state in [begin, end) into `state`.
+inline void parse_game_state(const char* begin, const char* end, GameState* state) {
+  StateParser(begin, end).parse(state);
+}
+
+#endif  // STATE_PARSER_H_
@@ -0,0 +1,482 @@
+// Tunes the evaluator's weights with the cross-entropy method, scoring every
+// sample by self-play against the simulator in simulator.h.
+//
+//   tune [--generations G] [--population P] [--elite E] [--games M]
+//        [--turns T] [--block-size K] [--seed S] [--threads J]
+//        [--sigma X] [--noise X] [--round R] [--z Z] [--no-early-stop]
+//        [--out FILE] [--checkpoint FILE] [--resume]
+//
+// Each generation draws P weight vectors (default 50) from a normal
+// distribution around the current mean, which starts at SHIPPED_WEIGHTS with
+// a standard deviation of X (--sigma, default 0.5). Each sample plays up to M
+// games (default 20) of at most T turns (default 1000), and its fitness is
+// its mean score. The E fittest (default 10) become the next distribution,
+// with --noise (default 0.05) added to every variance so it doesn't collapse
+// early. Games are played on J threads (default one per core).
+//
+// Every sample in a generation plays the same seeds, and they play R games
+// (default 4) at a time. After each round, a sample whose paired score
+// difference from the last elite sample is more than Z (default 2) standard
+// errors below zero stops playing, since it won't make the elite. Once only
+// the elite are left, they play out the rest of the M games, so the elite
+// are ranked on every game. --no-early-stop plays every game of every
+// sample.
+//
+// Each generation plays different seeds, so fitness from one generation
+// can't be compared with another's. Instead, the fittest sample of each
+// generation also plays M validation games, on seeds no generation plays,
+// and it replaces the best weights so far only if it does better on them.
+// The best weights start as SHIPPED_WEIGHTS, scored on the same games.
+//
+// After every generation the best weights so far are written to --out
+// (default tuned_weights.txt), in the format read_weights reads, and the
+// whole search state to --checkpoint (default tune.checkpoint). --resume
+// picks up from the checkpoint, and carries on exactly as the run that wrote
+// it would have.
+
+#include "dropblox_ai.h"
+#include "paired_stats.h"
+#include "simulator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <thread>
+
+using namespace std;
+
+static void usage(const char* name) {
+  cerr << "Usage: " << name << " [--generations G] [--population P] [--elite E] [--games M]"
+       << " [--turns T] [--block-size K] [--seed S] [--threads J] [--sigma X] [--noise X]"
+       << " [--round R] [--z Z] [--no-early-stop] [--out FILE] [--checkpoint FILE] [--resume]"
+       << endl;
+  exit(1);
+}
+
+struct TuneOptions {
+  int generations;
+  int population;
+  int elite;
+  int games;
+  int max_turns;
+  int block_size;
+  uint64_t seed;
+  int threads;
+  double sigma;
+  double noise;
+  int round;
+  bool early_stop;
+  double z;
+  const char* out;
+  const char* checkpoint;
+  bool resume;
+};
+
+// A weight vector and how well it played: its mean score over the games it
+// played.
+struct Sample {
+  Weights weights;
+  double fitness;
+  int games;
+};
+
+// Orders samples by how far they got in the race, then by fitness, so a
+// sample that was stopped early never ranks above one that wasn't.
+static bool fitter(const Sample& a, const Sample& b) {
+  if (a.games != b.games) {
+    return a.games > b.games;
+  }
+  return a.fitness > b.fitness;
+}
+
+// Everything the search needs to carry on from the end of a generation.
+struct TuneState {
+  int generation;
+  mt19937_64 rng;
+  double mean[NUM_FEATURES];
+  double sigma[NUM_FEATURES];
+  // The best weights so far, with their fitness on the validation games.
+  Sample best;
+  // The last generation, fittest first.
+  vector<Sample> population;
+};
+
+static const char CHECKPOINT_MAGIC[] = "dropblox-tune-checkpoint-3";
+
+static void write_sample(ostream& out, const Sample& sample) {
+  out << sample.fitness << " " << sample.games;
+  for (int f = 0; f < NUM_FEATURES; f++) {
+    out << " " << sample.weights.weights[f];
+  }
+  out << "\n";
+}
+
+static void read_sample(istream& in, Sample* sample) {
+  in >> sample->fitness >> sample->games;
+  for (int f = 0; f < NUM_FEATURES; f++) {
+    in >> sample->weights.weights[f];
+  }
+}
+
+// Reads a word from `in` and throws unless it is `expected`.
+static void expect(istream& in, const char* expected) {
+  string word;
+  if (!(in >> word) || word != expected) {
+    throw Exception(string("Malformed checkpoint: expected ") + expected);
+  }
+}
+
+// Writes the checkpoint to a temporary file and renames it into place, so an
+// interrupted write never leaves a truncated checkpoint behind.
+static void write_checkpoint(const char* path, const TuneState& state) {
+  string temp = string(path) + ".tmp";
+  {
+    ofstream out(temp.c_str());
+    out.precision(17);
+    out << CHECKPOINT_MAGIC << "\n";
+    out << "generation " << state.generation << "\n";
+    out << "rng " << state.rng << "\n";
+    out << "mean";
+    for (int f = 0; f < NUM_FEATURES; f++) {
+      out << " " << state.mean[f];
+    }
+    out << "\nsigma";
+    for (int f = 0; f < NUM_FEATURES; f++) {
+      out << " " << state.sigma[f];
+    }
+    out << "\nbest ";
+    write_sample(out, state.best);
+    out << "population " << state.population.size() << "\n";
+    for (size_t k = 0; k < state.population.size(); k++) {
+      write_sample(out, state.population[k]);
+    }
+    if (!out) {
+      throw Exception("Can't write " + temp);
+    }
+  }
+  if (rename(temp.c_str(), path) != 0) {
+    throw Exception("Can't replace " + string(path));
+  }
+}
+
+static void read_checkpoint(const char* path, TuneState* state) {
+  ifstream in(path);
+  if (!in) {
+    throw Exception("Can't open " + string(path));
+  }
+  expect(in, CHECKPOINT_MAGIC);
+  expect(in, "generation");
+  in >> state->generation;
+  expect(in, "rng");
+  in >> state->rng;
+  expect(in, "mean");
+  for (int f = 0; f < NUM_FEATURES; f++) {
+    in >> state->mean[f];
+  }
+  expect(in, "sigma");
+  for (int f = 0; f < NUM_FEATURES; f++) {
+    in >> state->sigma[f];
+  }
+  expect(in, "best");
+  read_sample(in, &state->best);
+  expect(in, "population");
+  size_t size = 0;
+  in >> size;
+  state->population.resize(size);
+  for (size_t k = 0; k < size; k++) {
+    read_sample(in, &state->population[k]);
+  }
+  if (!in) {
+    throw Exception("Malformed checkpoint " + string(path));
+  }
+}
+
+static void write_weights_file(const char* path, const Weights& weights) {
+  ofstream out(path);
+  write_weights(out, weights);
+  if (!out) {
+    throw Exception("Can't write " + string(path));
+  }
+}
+
+// One round of games: every sample in `active` plays games `first` to
+// `first + count - 1` of the generation, and sample c's score in game g goes
+// to scores[c * games + g].
+struct Round {
+  uint64_t seed;
+  const vector<Sample>* samples;
+  vector<int> active;
+  int first;
+  int count;
+  vector<int>* scores;
+};
+
+// Plays the round's games until there are none left, taking the next one
+// from `next`. Game g of a generation has seed round.seed + g for every
+// sample.
+static void run_worker(const TuneOptions& options, const Round& round, atomic<int>* next) {
+  int jobs = (int)round.active.size() * round.count;
+  int job;
+  while ((job = next->fetch_add(1)) < jobs) {
+    int c = round.active[job / round.count];
+    int g = round.first + job % round.count;
+    GameResult result = play_game<DEFAULT_ROWS, DEFAULT_COLS>(
+        round.seed + g, options.max_turns, options.block_size, NULL,
+        (*round.samples)[c].weights);
+    (*round.scores)[c * options.games + g] = result.score;
+  }
+}
+
+static bool higher_fitness(const pair<double, int>& a, const pair<double, int>& b) {
+  return a.first > b.first;
+}
+
+// Plays the samples' games, spread over the threads, and fills in their
+// fitness. All samples play the same seeds, so they're compared on the same
+// blocks. Games are played in rounds, and after each round a sample stops
+// if it's significantly worse than the sample in the last elite place, so
+// it can't end up in the elite. Once only the elite are left, they play the
+// rest of the games without stopping. Returns how many games were played.
+static int evaluate(const TuneOptions& options, uint64_t seed, vector<Sample>* samples) {
+  vector<int> scores(samples->size() * options.games);
+  Round round;
+  round.seed = seed;
+  round.samples = samples;
+  round.scores = &scores;
+  round.first = 0;
+  for (size_t c = 0; c < samples->size(); c++) {
+    round.active.push_back(c);
+  }
+  int played = 0;
+  while (round.first < options.games && (int)round.active.size() > 0) {
+    round.count = min(options.round, options.games - round.first);
+    atomic<int> next(0);
+    vector<thread> workers;
+    for (int t = 0; t < options.threads; t++) {
+      workers.push_back(thread(run_worker, cref(options), cref(round), &next));
+    }
+    for (size_t t = 0; t < workers.size(); t++) {
+      workers[t].join();
+    }
+    played += round.active.size() * round.count;
+    round.first += round.count;
+
+    vector<pair<double, int> > ranked;
+    for (size_t k = 0; k < round.active.size(); k++) {
+      int c = round.active[k];
+      Sample& sample = (*samples)[c];
+      sample.games = round.first;
+      double total = 0;
+      for (int g = 0; g < round.first; g++) {
+        total += scores[c * options.games + g];
+      }
+      sample.fitness = total / round.first;
+      ranked.push_back(make_pair(sample.fitness, c));
+    }
+    if (!options.early_stop || (int)ranked.size() <= options.elite) {
+      continue;
+    }
+    stable_sort(ranked.begin(), ranked.end(), higher_fitness);
+    const int* boundary = &scores[ranked[options.elite - 1].second * options.games];
+    vector<int> survivors;
+    for (size_t k = 0; k < ranked.size(); k++) {
+      int c = ranked[k].second;
+      PairedDifference difference =
+          paired_difference(boundary, &scores[c * options.games], round.first);
+      if ((int)k < options.elite || !significantly_positive(difference, options.z)) {
+        survivors.push_back(c);
+      }
+    }
+    sort(survivors.begin(), survivors.end());
+    round.active = survivors;
+  }
+  return played;
+}
+
+// The first seed of the validation games, far from any generation's.
+static uint64_t validation_seed(const TuneOptions& options) {
+  return options.seed + (1ULL << 63);
+}
+
+// Plays `sample` on every validation game and sets its fitness to its mean
+// score there. Returns how many games were played.
+static int validate(const TuneOptions& options, Sample* sample) {
+  TuneOptions all_games = options;
+  all_games.early_stop = false;
+  vector<Sample> samples(1, *sample);
+  int played = evaluate(all_games, validation_seed(options), &samples);
+  *sample = samples[0];
+  return played;
+}
+
+// Runs one generation: samples, evaluates and refits the distribution, and
+// validates the fittest sample, whose validation fitness goes in
+// `challenger_fitness`. Returns how many games were played.
+static int run_generation(const TuneOptions& options, TuneState* state,
+                          double* challenger_fitness) {
+  normal_distribution<double> normal;
+  vector<Sample> samples(options.population);
+  for (int c = 0; c < options.population; c++) {
+    for (int f = 0; f < NUM_FEATURES; f++) {
+      samples[c].weights.weights[f] = state->mean[f] + state->sigma[f] * normal(state->rng);
+    }
+  }
+  int played = evaluate(options, options.seed + (uint64_t)state->generation * options.games,
+                        &samples);
+
+  stable_sort(samples.begin(), samples.end(), fitter);
+  for (int f = 0; f < NUM_FEATURES; f++) {
+    double mean = 0;
+    for (int e = 0; e < options.elite; e++) {
+      mean += samples[e].weights.weights[f];
+    }
+    mean /= options.elite;
+    double variance = 0;
+    for (int e = 0; e < options.elite; e++) {
+      double d = samples[e].weights.weights[f] - mean;
+      variance += d * d;
+    }
+    variance /= options.elite;
+    state->mean[f] = mean;
+    state->sigma[f] = sqrt(variance + options.noise);
+  }
+  // The fittest sample's fitness came from this generation's seeds; it has
+  // to beat the best so far on the validation games to replace it.
+  Sample challenger = samples[0];
+  played += validate(options, &challenger);
+  *challenger_fitness = challenger.fitness;
+  if (challenger.fitness > state->best.fitness) {
+    state->best = challenger;
+  }
+  state->population = samples;
+  state->generation++;
+  return played;
+}
+
+int main(int argc, char** argv) {
+  TuneOptions options;
+  options.generations = 20;
+  options.population = 50;
+  options.elite = 10;
+  options.games = 20;
+  options.max_turns = 1000;
+  options.block_size = SIMULATED_BLOCK_SIZE;
+  options.seed = 1;
+  options.threads = max(1u, thread::hardware_concurrency());
+  options.sigma = 0.5;
+  options.noise = 0.05;
+  options.round = 4;
+  options.early_stop = true;
+  options.z = 2;
+  options.out = "tuned_weights.txt";
+  options.checkpoint = "tune.checkpoint";
+  options.resume = false;
+  for (int k = 1; k < argc; k++) {
+    if (strcmp(argv[k], "--resume") == 0) {
+      options.resume = true;
+      continue;
+    }
+    if (strcmp(argv[k], "--no-early-stop") == 0) {
+      options.early_stop = false;
+      continue;
+    }
+    if (k + 1 == argc) {
+      usage(argv[0]);
+    }
+    if (strcmp(argv[k], "--generations") == 0) {
+      options.generations = atoi(argv[++k]);
+    } else if (strcmp(argv[k], "--population") == 0) {
+      options.population = atoi(argv[++k]);
+    } else if (strcmp(argv[k], "--elite") == 0) {
+      options.elite = atoi(argv[++k]);
+    } else if (strcmp(argv[k], "--games") == 0) {
+      options.games = atoi(argv[++k]);
+    } else if (strcmp(argv[k], "--turns") == 0) {
+      options.max_turns = atoi(argv[++k]);
+    } else if (strcmp(argv[k], "--block-size") == 0) {
+      options.block_size = atoi(argv[++k]);
+    } else if (strcmp(argv[k], "--seed") == 0) {
+      options.seed = strtoull(argv[++k], NULL, 10);
+    } else if (strcmp(argv[k], "--threads") == 0) {
+      options.threads = atoi(argv[++k]);
+    } else if (strcmp(argv[k], "--sigma") == 0) {
+      options.sigma = atof(argv[++k]);
+    } else if (strcmp(argv[k], "--noise") == 0) {
+      options.noise = atof(argv[++k]);
+    } else if (strcmp(argv[k], "--round") == 0) {
+      options.round = atoi(argv[++k]);
+    } else if (strcmp(argv[k], "--z") == 0) {
+      options.z = atof(argv[++k]);
+    } else if (strcmp(argv[k], "--out") == 0) {
+      options.out = argv[++k];
+    } else if (strcmp(argv[k], "--checkpoint") == 0) {
+      options.checkpoint = argv[++k];
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (options.population <= 0 || options.elite <= 0 || options.elite > options.population ||
+      options.games <= 0 || options.threads <= 0 || options.round <= 0) {
+    usage(argv[0]);
+  }
+
+  engine_debug = false;
+  TuneState state;
+  try {
+    if (options.resume) {
+      read_checkpoint(options.checkpoint, &state);
+      printf("Resuming from %s after generation %d\n", options.checkpoint, state.generation);
+    } else {
+      state.generation = 0;
+      state.rng.seed(options.seed);
+      for (int f = 0; f < NUM_FEATURES; f++) {
+        state.mean[f] = SHIPPED_WEIGHTS.weights[f];
+        state.sigma[f] = options.sigma;
+      }
+      state.best.weights = SHIPPED_WEIGHTS;
+      validate(options, &state.best);
+      printf("shipped weights: %.1f on the validation games\n", state.best.fitness);
+    }
+
+    typedef chrono::steady_clock Clock;
+    while (state.generation < options.generations) {
+      Clock::time_point start = Clock::now();
+      double challenger_fitness;
+      int played = run_generation(options, &state, &challenger_fitness);
+      double elapsed = chrono::duration<double>(Clock::now() - start).count();
+
+      double elite_fitness = 0;
+      for (int e = 0; e < options.elite; e++) {
+        elite_fitness += state.population[e].fitness;
+      }
+      double mean_sigma = 0;
+      for (int f = 0; f < NUM_FEATURES; f++) {
+        mean_sigma += state.sigma[f] / NUM_FEATURES;
+      }
+      printf("generation %d: fittest %.1f (%.1f validated), elite mean %.1f, best so far %.1f"
+             " validated, mean sigma %.3f, %d of %d games (%.1fs)\n", state.generation,
+             state.population[0].fitness, challenger_fitness, elite_fitness / options.elite,
+             state.best.fitness, mean_sigma, played, (options.population + 1) * options.games,
+             elapsed);
+      fflush(stdout);
+
+      write_weights_file(options.out, state.best.weights);
+      write_checkpoint(options.checkpoint, state);
+    }
+  } catch (const Exception& e) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  cout << "Best weights (fitness " << state.best.fitness << " on the validation games), written to "
+       << options.out << ":" << endl;
+  write_weights(cout, state.best.weights);
+  return 0;
+}
@@ -0,0 +1,192 @@
+#ifndef TURN_STATS_H_
+#define TURN_STATS_H_
+
+#include "perf_counters.h"
+
+#include <chrono>
+#include <ostream>
+
+// What the engine did in one turn and where the time went, written by main()
+// as a single line of JSON when DROPBLOX_STATS_FD names a file descriptor:
+//
+//   DROPBLOX_STATS_FD=3 ./dropblox_ai @state.json 10 3>>turns.jsonl
+//
+// Timing a phase costs a clock read at each end, so only turns that are
+// being recorded pay for it: pick_move times nothing unless its
+// MoveScratch has a TurnStats to fill in.
+//
+// With DROPBLOX_PERF_COUNTERS=1 as well, each phase also counts cycles,
+// instructions, cache misses and branch misses (see perf_counters.h). That
+// adds a system call at each end of a phase, a few microseconds a turn.
+//
+// Only what the engine measures is written. pick_move searches one ply on
+// one thread, with no transposition table and nothing to prune, so there
+// are no fields for those; "merged" over "nodes_per_ply" is the nearest
+// thing to a table hit rate.
+
+// The phases of a turn, in order.
+enum TurnPhase {
+  // Reading the state into a GameState.
+  PHASE_PARSE = 0,
+  // Building the board.
+  PHASE_SETUP,
+  // generate_placements.
+  PHASE_GENERATE,
+  // Dropping the block from every placement, and looking each board up.
+  PHASE_PLACE,
+  // Scoring the distinct boards the placements land on.
+  PHASE_EVALUATE,
+  // Picking the best score and turning it into commands.
+  PHASE_SELECT,
+  NUM_TURN_PHASES
+};
+
+static const char* const TURN_PHASE_NAMES[NUM_TURN_PHASES] = {
+  "parse",
+  "setup",
+  "generate",
+  "place",
+  "evaluate",
+  "select",
+};
+
+struct TurnStats {
+  double seconds[NUM_TURN_PHASES];
+  // Placements generated at each ply. pick_move only looks one ply ahead.
+  int placements;
+  // Boards scored by evaluate_batch.
+  int evaluations;
+  // Placements that landed on a board another placement already landed on,
+  // and shared its score.
+  int merged;
+  // The time the client allows for the turn, or a negative number if it
+  // didn't say.
+  double seconds_allowed;
+  // The hardware counters to read at each end of a phase, or NULL, and what
+  // they counted in each phase. A phase's counts aren't valid if, any time
+  // it ran, the counters couldn't be read at either end of it or weren't
+  // scheduled on the PMU at all in between.
+  const PerfCounters* perf;
+  uint64_t counters[NUM_TURN_PHASES][NUM_PERF_COUNTERS];
+  bool counters_valid[NUM_TURN_PHASES];
+
+  TurnStats()
+      : placements(0), evaluations(0), merged(0), seconds_allowed(-1), perf(NULL) {
+    for (int phase = 0; phase < NUM_TURN_PHASES; phase++) {
+      seconds[phase] = 0;
+      counters_valid[phase] = true;
+      for (int c = 0; c < NUM_PERF_COUNTERS; c++) {
+        counters[phase][c] = 0;
+      }
+    }
+  }
+
+  double total_seconds() const {
+    double total = 0;
+    for (int phase = 0; phase < NUM_TURN_PHASES; phase++) {
+      total += seconds[phase];
+    }
+    return total;
+  }
+};
+
+// Charges the time, and the counts of stats->perf if any, between calls of
+// next() to the phase named in the earlier call. Does nothing if `stats` is
+// NULL.
+class PhaseClock {
+ public:
+  explicit PhaseClock(TurnStats* stats)
+      : stats(stats), phase(NUM_TURN_PHASES), start_read(false) {}
+
+  ~PhaseClock() { stop(); }
+
+  // Ends the current phase, if any, and starts `next_phase`.
+  void next(TurnPhase next_phase) {
+    if (!stats) {
+      return;
+    }
+    stop();
+    phase = next_phase;
+    start = Clock::now();
+    if (stats->perf) {
+      start_read = stats->perf->read_all(&start_reading);
+    }
+  }
+
+  // Ends the current phase.
+  void stop() {
+    if (!stats || phase == NUM_TURN_PHASES) {
+      return;
+    }
+    if (stats->perf) {
+      PerfReading end_reading;
+      uint64_t counts[NUM_PERF_COUNTERS];
+      if (start_read && stats->perf->read_all(&end_reading) &&
+          perf_delta(start_reading, end_reading, counts)) {
+        for (int c = 0; c < NUM_PERF_COUNTERS; c++) {
+          stats->counters[phase][c] += counts[c];
+        }
+      } else {
+        stats->counters_valid[phase] = false;
+      }
+    }
+    stats->seconds[phase] += std::chrono::duration<double>(Clock::now() - start).count();
+    phase = NUM_TURN_PHASES;
+  }
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+  TurnStats* stats;
+  TurnPhase phase;
+  Clock::time_point start;
+  PerfReading start_reading;
+  // Whether start_reading was read.
+  bool start_read;
+
+  PhaseClock(const PhaseClock&);
+  PhaseClock& operator=(const PhaseClock&);
+};
+
+// Writes the stats as one line of JSON. Times are in seconds.
+inline void write_turn_stats(const TurnStats& stats, int rows, int cols, std::ostream& out) {
+  double total = stats.total_seconds();
+  out << "{\"rows\": " << rows << ", \"cols\": " << cols << ", \"seconds\": " << total
+      << ", \"phases\": {";
+  for (int phase = 0; phase < NUM_TURN_PHASES; phase++) {
+    out << (phase ? ", " : "") << "\"" << TURN_PHASE_NAMES[phase]
+        << "\": " << stats.seconds[phase];
+  }
+  out << "}, \"nodes_per_ply\": [" << stats.placements << "]"
+      << ", \"evaluations\": " << stats.evaluations
+      << ", \"merged\": " << stats.merged;
+  if (stats.perf && stats.perf->available()) {
+    out << ", \"counters\": {";
+    for (int phase = 0; phase < NUM_TURN_PHASES; phase++) {
+      out << (phase ? ", " : "") << "\"" << TURN_PHASE_NAMES[phase] << "\": ";
+      if (!stats.counters_valid[phase]) {
+        out << "null";
+        continue;
+      }
+      out << "{";
+      bool first = true;
+      for (int c = 0; c < NUM_PERF_COUNTERS; c++) {
+        if (stats.perf->has(c)) {
+          out << (first ? "" : ", ") << "\"" << PERF_COUNTER_NAMES[c]
+              << "\": " << stats.counters[phase][c];
+          first = false;
+        }
+      }
+      out << "}";
+    }
+    out << "}";
+  } else if (stats.perf) {
+    out << ", \"counters_error\": \"" << stats.perf->get_error() << "\"";
+  }
+  if (stats.seconds_allowed >= 0) {
+    out << ", \"seconds_allowed\": " << stats.seconds_allowed
+        << ", \"deadline_margin\": " << stats.seconds_allowed - total;
+  }
+  out << "}" << std::endl;
+}
+
+#endif  // TURN_STATS_H_
@@ -0,0 +1,329 @@
+#!/usr/bin/env python
+#
+# A local stand-in for the game server, so client.py can be run end to end
+# without a network. It speaks the same HTTP/JSON protocol as
+# playdropblox.com, using the response codes in helpers/messaging.py, and
+# every game is played by the native simulator (C++/simulate --step).
+#
+# Run it, then point the client at it:
+#
+#   python local_server.py --latency 50
+#   DROPBLOX_DEBUG=1 python client.py practice
+#
+# --latency adds a delay to every response, to measure how much of the time
+# budget the transport takes. When a game ends, the server prints how long
+# each move spent in the client compared to in transit.
+#
+# A game's simulator is stopped as soon as the game ends. One that no move
+# has been submitted to for --idle-timeout seconds is taken to be abandoned:
+# its simulator is stopped too, and the game counts as failed.
+#
+
+import json
+import optparse
+import os
+import random
+import subprocess
+import sys
+import threading
+import time
+
+try:
+    from BaseHTTPServer import BaseHTTPRequestHandler, HTTPServer
+    from SocketServer import ThreadingMixIn
+except ImportError:
+    from http.server import BaseHTTPRequestHandler, HTTPServer
+    from socketserver import ThreadingMixIn
+
+from helpers import messaging
+
+SERVER_PATH = os.path.dirname(os.path.abspath(__file__))
+SIMULATOR_PATH = os.path.join(SERVER_PATH, 'C++', 'simulate')
+
+VALID_CMDS = ['left', 'right', 'up', 'down', 'rotate']
+
+
+class Game(object):
+    """One game, played by a simulator subprocess in step mode."""
+
+    def __init__(self, game_id, seed, options):
+        self.id = game_id
+        self.seed = seed
+        self.lock = threading.Lock()
+        self.number_moves_made = 0
+        self.seconds = options.seconds
+        self.started = time.time()
+        # When the game was created or last had a move submitted to it.
+        self.last_active = self.started
+        # When the last response for this game was written, and how long the
+        # client then took to send each move: its think time plus the trip.
+        self.last_response = None
+        self.think_times = []
+        self.process = subprocess.Popen(
+            [options.simulator, '--step', '--seed', str(seed),
+             '--block-size', str(options.block_size)],
+            stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+            universal_newlines=True)
+        try:
+            self.game_state = self._read_state()
+        except Exception:
+            self.finish()
+            raise
+
+    def _read_state(self):
+        line = self.process.stdout.readline()
+        if not line:
+            raise Exception('Simulator for game %d exited' % self.id)
+        return json.loads(line)
+
+    def seconds_remaining(self):
+        return max(0.0, self.seconds - (time.time() - self.started))
+
+    def is_over(self):
+        return self.game_state['state'] != 'playing'
+
+    def submit(self, move_list):
+        self.process.stdin.write(' '.join(move_list) + '\n')
+        self.process.stdin.flush()
+        self.game_state = self._read_state()
+        self.number_moves_made += 1
+
+    def is_finished(self):
+        return self.process.returncode is not None
+
+    def finish(self):
+        """Stops the simulator, if it's still running, and reaps it."""
+        if self.is_finished():
+            return
+        for pipe in (self.process.stdin, self.process.stdout):
+            try:
+                pipe.close()
+            except (IOError, OSError):
+                pass
+        if self.process.poll() is None:
+            self.process.terminate()
+        self.process.wait()
+
+    def to_dict(self):
+        return {
+            'id': self.id,
+            'number_moves_made': self.number_moves_made,
+            'game_state': self.game_state,
+        }
+
+
+class GameServer(ThreadingMixIn, HTTPServer):
+    daemon_threads = True
+
+    def __init__(self, address, options):
+        HTTPServer.__init__(self, address, RequestHandler)
+        self.options = options
+        self.games = {}
+        self.games_lock = threading.Lock()
+        self.next_id = 1
+        self.next_seed = options.seed
+        self.compete_waits = options.compete_waits
+        self.reaper = threading.Thread(target=self._reap_idle_games)
+        self.reaper.daemon = True
+        self.reaper.start()
+
+    def new_game(self):
+        with self.games_lock:
+            game_id = self.next_id
+            self.next_id += 1
+            seed = self.next_seed
+            self.next_seed += 1
+        game = Game(game_id, seed, self.options)
+        with self.games_lock:
+            self.games[game_id] = game
+        print('Game %d started with seed %d' % (game_id, seed))
+        return game
+
+    def get_game(self, game_id):
+        with self.games_lock:
+            return self.games.get(game_id)
+
+    def _reap_idle_games(self):
+        timeout = self.options.idle_timeout
+        while True:
+            time.sleep(min(timeout / 4.0, 5.0))
+            with self.games_lock:
+                games = list(self.games.values())
+            for game in games:
+                with game.lock:
+                    if game.is_finished() or time.time() - game.last_active < timeout:
+                        continue
+                    game.finish()
+                    if not game.is_over():
+                        game.game_state['state'] = 'failed'
+                print('Game %d abandoned after %d moves; simulator stopped' %
+                      (game.id, game.number_moves_made))
+
+    def finish_games(self):
+        with self.games_lock:
+            games = list(self.games.values())
+        for game in games:
+            with game.lock:
+                game.finish()
+
+
+class RequestHandler(BaseHTTPRequestHandler):
+
+    def log_message(self, format, *args):
+        if self.server.options.verbose:
+            BaseHTTPRequestHandler.log_message(self, format, *args)
+
+    def _respond(self, code, body, game=None):
+        latency = self.server.options.latency
+        jitter = self.server.options.jitter
+        delay = latency + (random.uniform(-jitter, jitter) if jitter else 0)
+        if delay > 0:
+            time.sleep(delay / 1000.0)
+        data = json.dumps(body).encode('utf-8')
+        self.send_response(code)
+        self.send_header('Content-Type', 'application/json')
+        self.send_header('Content-Length', str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+        if game is not None:
+            game.last_response = time.time()
+
+    def _game_response(self, game, ret='ok', code=None, reason=None):
+        body = {
+            'ret': ret,
+            'game': game.to_dict(),
+            'competition_seconds_remaining': game.seconds_remaining(),
+        }
+        if code is not None:
+            body['code'] = code
+            body['reason'] = reason
+        return body
+
+    def do_POST(self):
+        length = int(self.headers.get('Content-Length', 0))
+        try:
+            request = json.loads(self.rfile.read(length).decode('utf-8'))
+        except ValueError:
+            self._respond(400, {'ret': 'fail', 'reason': 'Malformed JSON'})
+            return
+
+        password = self.server.options.password
+        if 'team_name' not in request or \
+           (password is not None and request.get('password') != password):
+            self._respond(401, {'ret': 'fail', 'reason': 'Not authorized',
+                                'code': messaging.CODE_TEAM_NOT_AUTHORIZED})
+            return
+
+        if self.path == '/create_practice_game':
+            game = self.server.new_game()
+            self._respond(200, self._game_response(game), game)
+        elif self.path == '/get_compete_game':
+            self._get_compete_game()
+        elif self.path == '/submit_game_move':
+            self._submit_game_move(request)
+        else:
+            self._respond(404, {'ret': 'fail', 'reason': 'Unknown path'})
+
+    def _get_compete_game(self):
+        with self.server.games_lock:
+            wait = self.server.compete_waits > 0
+            if wait:
+                self.server.compete_waits -= 1
+        if wait:
+            self._respond(200, {'ret': 'wait', 'wait_time': 0.5})
+        else:
+            game = self.server.new_game()
+            self._respond(200, self._game_response(game), game)
+
+    def _submit_game_move(self, request):
+        game = self.server.get_game(request.get('game_id'))
+        if game is None:
+            self._respond(200, {'ret': 'fail',
+                                'code': messaging.CODE_GAMES_DOES_NOT_EXIST,
+                                'reason': 'No such game'})
+            return
+
+        with game.lock:
+            game.last_active = time.time()
+            if game.last_response is not None:
+                game.think_times.append(time.time() - game.last_response)
+            if game.is_over():
+                body = self._game_response(game, 'fail', messaging.CODE_GAME_OVER,
+                                           'Game over')
+            elif request.get('moves_made') != game.number_moves_made:
+                body = self._game_response(game, 'fail', messaging.CODE_CONCURRENT_MOVE,
+                                           'Expected move %d' % game.number_moves_made)
+            else:
+                moves = [move for move in request.get('move_list', [])
+                         if move in VALID_CMDS]
+                game.submit(moves)
+                if game.seconds_remaining() <= 0:
+                    game.game_state['state'] = 'failed'
+                if game.is_over():
+                    body = self._game_response(game, 'fail', messaging.CODE_GAME_OVER,
+                                               'Game over')
+                    self._report(game)
+                else:
+                    body = self._game_response(game)
+        self._respond(200, body, game)
+
+    def _report(self, game):
+        game.finish()
+        moves = len(game.think_times)
+        if moves:
+            # Every move waits out the injected latency once, on the response
+            # that carried its state, before the client sees the board.
+            latency = self.server.options.latency / 1000.0
+            client = sum(game.think_times) / moves
+            print('Game %d over: score %d after %d moves; per move %.3fs in the client '
+                  'and %.3fs of injected latency (%.0f%% of the round trip)' %
+                  (game.id, game.game_state['score'], game.number_moves_made, client,
+                   latency, 100.0 * latency / (latency + client) if latency + client else 0))
+        else:
+            print('Game %d over: score %d' % (game.id, game.game_state['score']))
+
+
+def main(argv):
+    parser = optparse.OptionParser(usage='%prog [options]')
+    parser.add_option('--port', type='int', default=8080,
+                      help='port to listen on; client.py uses 8080 [default: %default]')
+    parser.add_option('--latency', type='float', default=0,
+                      help='milliseconds to delay every response [default: %default]')
+    parser.add_option('--jitter', type='float', default=0,
+                      help='random +/- milliseconds added to the latency [default: %default]')
+    parser.add_option('--seed', type='int', default=1,
+                      help='seed of the first game; each new game uses the next [default: %default]')
+    parser.add_option('--block-size', type='int', default=5,
+                      help='largest blocks dealt [default: %default]')
+    parser.add_option('--seconds', type='float', default=600,
+                      help='time budget for each game [default: %default]')
+    parser.add_option('--compete-waits', type='int', default=0,
+                      help='"wait" responses to send before a compete game starts [default: %default]')
+    parser.add_option('--idle-timeout', type='float', default=60,
+                      help='seconds without a move before a game is abandoned and its '
+                      'simulator stopped [default: %default]')
+    parser.add_option('--password', default=None,
+                      help='require this team password; any is accepted by default')
+    parser.add_option('--simulator', default=SIMULATOR_PATH,
+                      help='path to the simulate binary [default: %default]')
+    parser.add_option('-v', '--verbose', action='store_true', default=False,
+                      help='log every request')
+    options, args = parser.parse_args(argv[1:])
+    if args:
+        parser.error('unexpected arguments: %s' % ' '.join(args))
+    if options.idle_timeout <= 0:
+        parser.error('--idle-timeout must be positive')
+    if not os.path.exists(options.simulator):
+        parser.error('%s not found; run make in C++/ first' % options.simulator)
+
+    server = GameServer(('localhost', options.port), options)
+    print('Serving games on http://localhost:%d' % options.port)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    server.finish_games()
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -16,6 +16,48 @@
 #include "choose_move.h"
 #include "dropblox_ai.h"
 
+const char * const FEATURE_NAMES[NUM_FEATURES] = {
+    "BLOCK_EDGES",
+    "BLOCK_HEIGHT",
+    "BUMPINESS",
+    "COL_TRANSITIONS",
+    "COVERS",
+    "EXTERNAL_EDGES",
+    "GAPS",
+    "HOLES",
+    "LANDING_HEIGHT",
+    "MAX_HEIGHT",
+    "POINTS_EARNED",
+    "ROWS_CLEARED",
+    "ROW_TRANSITIONS",
+    "WALL_EDGES",
+    "WELL_SUMS",
+};
+
+ScoreVector::ScoreVector() {
+    for (int f = 0; f < NUM_FEATURES; f++) {
+        weights[f] = 0.0;
+        has_weight[f] = false;
+    }
+}
+
+/*!
+ * Sets the weight of the feature with the given name.
+ *
+ * @param key the feature name
+ * @param value its weight
+ */
+void ScoreVector::SetWeight(const std::string& key, double value) {
+    for (int f = 0; f < NUM_FEATURES; f++) {
+        if (key == FEATURE_NAMES[f]) {
+            weights[f] = value;
+            has_weight[f] = true;
+            return;
+        }
+    }
+    std::cerr << "Ignoring weight for unknown feature " << key << std::endl;
+}
+
 /*!
  * Loads weights from a file, in
  *
@@ -31,13 +73,13 @@ void ScoreVector::LoadWeightsFromFile(const char * fname) {
 
     if (f.fail() || !f.is_open()) {
         // apply default weights
-        weights["POINTS_EARNED"] = 0.378565931393;
-        weights["ROW_TRANSITIONS"] = -0.548886169599;
-        weights["LANDING_HEIGHT"] =  0.71240334146;
-        weights["HOLES"] = -1.99902287016;
-        weights["BLOCK_HEIGHT"] = -0.00978251322273;
-        weights["WELL_SUMS"] = -0.151923526632;
-        weights["COL_TRANSITIONS"] = -0.793256698244;
+        SetWeight("POINTS_EARNED", 0.378565931393);
+        SetWeight("ROW_TRANSITIONS", -0.548886169599);
+        SetWeight("LANDING_HEIGHT",  0.71240334146);
+        SetWeight("HOLES", -1.99902287016);
+        SetWeight("BLOCK_HEIGHT", -0.00978251322273);
+        SetWeight("WELL_SUMS", -0.151923526632);
+        SetWeight("COL_TRANSITIONS", -0.793256698244);
     } else {
         while (std::getline(f, line)) {
             std::stringstream parse(line);
@@ -45,7 +87,7 @@ void ScoreVector::LoadWeightsFromFile(const char * fname) {
             std::string key;
             parse >> key >> value;
 
-            weights[key] = value;
+            SetWeight(key, value);
         }
     }
 
@@ -64,11 +106,11 @@ void ScoreVector::WriteWeightsToFile(std::string fname) {
 
     f.open(fname.c_str());
 
-    // write all items to file
-    for (std::map<std::string, double>::iterator iter = weights.begin(); iter != weights.end(); ++iter) {
-        std::string key = iter->first;
-        double weight = iter->second;
-        f << key << " " << weight << std::endl;
+    // write all weights that were set to file
+    for (int feature = 0; feature < NUM_FEATURES; feature++) {
+        if (has_weight[feature]) {
+            f << FEATURE_NAMES[feature] << " " << weights[feature] << std::endl;
+        }
     }
 
     f.close();
@@ -412,7 +454,7 @@ std::vector<move_t> FindBestMove(Board* board, const char* config) {
  * @param landing_height, set to <0 to recalculate.
  */
 double ScoreVector::Score(Board* board, int landing_height) {
-    std::map<std::string, double> values;
+    double values[NUM_FEATURES];
 
     int max_height = 0;
 
@@ -544,30 +586,27 @@ double ScoreVector::Score(Board* board, int landing_height) {
 
     double score = 0.0;
 
-    values["BLOCK_EDGES"] = max(edges.first, 0);
-    values["WALL_EDGES"] = max(edges.second, 0);
-    values["EXTERNAL_EDGES"] = max(edges.first + edges.second, 0);
-    values["GAPS"] = gaps;
-    values["MAX_HEIGHT"] = max_height;
-    values["BLOCK_HEIGHT"] = block_height;
+    values[BLOCK_EDGES] = max(edges.first, 0);
+    values[WALL_EDGES] = max(edges.second, 0);
+    values[EXTERNAL_EDGES] = max(edges.first + edges.second, 0);
+    values[GAPS] = gaps;
+    values[MAX_HEIGHT] = max_height;
+    values[BLOCK_HEIGHT] = block_height;
     points = (1 << board->rows_cleared) - 1;
-    values["POINTS_EARNED"] = points;
-    values["COVERS"] = covers;
-    values["BUMPINESS"] = bumpiness;
-
-    values["ROW_TRANSITIONS"] = row_transitions;
-    values["COL_TRANSITIONS"] = col_transitions;
-    values["ROWS_CLEARED"] = board->rows_cleared;
-    values["LANDING_HEIGHT"] = landing_height;
-    values["WELL_SUMS"] = well_sums;
-    values["HOLES"] = holes;
-
-    for (std::map<std::string, double>::iterator iter = values.begin(); iter != values.end(); ++iter) {
-        std::string key = iter->first;
-        double val = iter->second;
-        if (weights.count(key) > 0) {
-            score += val * weights[key];
-        }
+    values[POINTS_EARNED] = points;
+    values[COVERS] = covers;
+    values[BUMPINESS] = bumpiness;
+
+    values[ROW_TRANSITIONS] = row_transitions;
+    values[COL_TRANSITIONS] = col_transitions;
+    values[ROWS_CLEARED] = board->rows_cleared;
+    values[LANDING_HEIGHT] = landing_height;
+    values[WELL_SUMS] = well_sums;
+    values[HOLES] = holes;
+
+    // features without a weight have weight 0, so this is a plain dot product
+    for (int feature = 0; feature < NUM_FEATURES; feature++) {
+        score += values[feature] * weights[feature];
     }
 
     return score;
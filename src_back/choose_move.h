@@ -58,18 +58,53 @@ inline bool operator>=(const pose_t& lhs, const pose_t& rhs) {
     return !operator< (lhs,rhs);
 }
 
+/*!
+ * The features ScoreVector::Score computes for a board. They're listed in
+ * alphabetical order of their names, which is the order Score sums them in.
+ */
+typedef enum {
+    BLOCK_EDGES = 0,
+    BLOCK_HEIGHT,
+    BUMPINESS,
+    COL_TRANSITIONS,
+    COVERS,
+    EXTERNAL_EDGES,
+    GAPS,
+    HOLES,
+    LANDING_HEIGHT,
+    MAX_HEIGHT,
+    POINTS_EARNED,
+    ROWS_CLEARED,
+    ROW_TRANSITIONS,
+    WALL_EDGES,
+    WELL_SUMS,
+    NUM_FEATURES
+} feature_t;
+
+/*!
+ * The name of each feature, as used in weight files.
+ */
+extern const char * const FEATURE_NAMES[NUM_FEATURES];
+
 /*!
  * Determines how to score a given outcome
  */
 class ScoreVector {
     public:
+        ScoreVector();
+
         void LoadWeightsFromFile(const char * fname);
         void WriteWeightsToFile(std::string fname);
 
         double Score(Board* board, int landing_height=-1);
 
     private:
-        std::map<std::string, double> weights;
+        void SetWeight(const std::string& key, double value);
+
+        // indexed by feature_t; features without a weight are 0.
+        double weights[NUM_FEATURES];
+        // whether each weight was set, so only those are written back out.
+        bool has_weight[NUM_FEATURES];
 };
 
 std::string StringifyMove(const move_t& m);